@@ -0,0 +1,41 @@
+#ifndef ADMISSION_H
+#define ADMISSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define ADMISSION_MAX_INFLIGHT 1024
+#define ADMISSION_MAX_QUEUE_WAIT_MS 250
+#define ADMISSION_MAX_DB_BUSY_MS 500
+#define ADMISSION_SAMPLE_TTL_MS 1000
+#define STATS_PATH "/_blink/stats"
+
+typedef enum {
+    ADMIT_OK,
+    SHED_INFLIGHT,
+    SHED_QUEUE_WAIT,
+    SHED_DB_BUSY,
+    SHED_QUEUE_FULL,
+    ADMISSION_DECISIONS
+} admission_decision_t;
+
+/*
+ * Process-wide admission controller. Requests past any threshold are
+ * answered with a 503 instead of being queued. Queue wait and SQLite
+ * busy time are moving averages that halve for every
+ * ADMISSION_SAMPLE_TTL_MS without samples, so shedding stops once the
+ * backlog is gone and one slow sample after a quiet spell does not start
+ * it. The SQLite threshold is checked by admit_query(), only for requests
+ * about to run a query. A threshold of 0 disables that check.
+ */
+void configure_admission(int max_inflight, int max_queue_wait_ms, int max_db_busy_ms);
+admission_decision_t admit_request(void);
+bool admit_query(void);
+void finish_admitted_request(void);
+void record_shed(admission_decision_t reason);
+void record_queue_wait(long long wait_us);
+void record_db_busy(long long busy_us);
+long long monotonic_us(void);
+int format_admission_stats(char* buffer, size_t size);
+
+#endif
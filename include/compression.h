@@ -0,0 +1,33 @@
+#ifndef COMPRESSION_H
+#define COMPRESSION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define COMPRESS_MIN_SIZE 256
+#define COMPRESS_MAX_SIZE (8 * 1024 * 1024)
+#define GZIP_LEVEL 9
+
+// In order of preference when a client accepts several
+typedef enum {
+    ENCODING_BROTLI,
+    ENCODING_GZIP,
+    ENCODING_COUNT
+} content_encoding_t;
+
+struct file_cache_entry;
+
+/*
+ * Compressed variants are built once per cache entry on a background
+ * thread and stored with it, so requests never compress. A request
+ * that arrives before the variants are ready is served uncompressed.
+ */
+int init_compression(bool enabled);
+bool compression_enabled(void);
+bool encoding_supported(content_encoding_t encoding);
+const char* encoding_token(content_encoding_t encoding);
+const char* encoding_extension(content_encoding_t encoding);
+bool schedule_compression(struct file_cache_entry* entry);
+void free_compression(void);
+
+#endif
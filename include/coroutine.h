@@ -0,0 +1,48 @@
+#ifndef COROUTINE_H
+#define COROUTINE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <ucontext.h>
+
+#define COROUTINE_STACK_SIZE (256 * 1024)
+#define COROUTINE_POOL_MAX 256
+
+typedef void (*coroutine_fn)(void* arg);
+typedef void (*blocking_fn)(void* arg);
+
+struct coroutine;
+typedef bool (*offload_fn)(struct coroutine* co, blocking_fn fn, void* arg);
+
+/*
+ * Stackful coroutine on an mmap'd stack with a guard page. Handlers run
+ * on the event loop thread and call run_blocking() for work that may
+ * block; the owner's offload hook hands it to another thread and the
+ * coroutine is suspended until the owner resumes it. If the hook refuses
+ * the step, it is skipped, run_blocking() returns false and the coroutine
+ * is marked shed so the owner can discard whatever it built.
+ */
+typedef struct coroutine {
+    ucontext_t context;
+    ucontext_t caller;
+    char* stack;
+    coroutine_fn fn;
+    void* arg;
+    offload_fn offload;
+    bool finished;
+    bool shed;
+    struct coroutine* next;
+} coroutine_t;
+
+typedef struct {
+    coroutine_t* free_list;
+    int free_count;
+} coroutine_pool_t;
+
+coroutine_t* create_coroutine(coroutine_pool_t* pool, coroutine_fn fn, void* arg, offload_fn offload);
+bool resume_coroutine(coroutine_t* co);
+void release_coroutine(coroutine_pool_t* pool, coroutine_t* co);
+void free_coroutine_pool(coroutine_pool_t* pool);
+bool run_blocking(blocking_fn fn, void* arg);
+
+#endif
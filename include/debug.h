@@ -1,7 +1,26 @@
 #ifndef DEBUG_H
 #define DEBUG_H
 
+#include <stdbool.h>
+#include <stdio.h>
+
 // Uncomment the line below to enable debug messages
 // #define DEBUG_MODE
 
+/*
+ * Production mode drops development work from the request path: no
+ * hot reload script or reload broadcasts, no per-request console
+ * output, and validators for conditional GET. --production turns it on
+ * at runtime. A BLINK_PRODUCTION build makes it a constant, so the
+ * development branches are compiled out.
+ */
+#ifdef BLINK_PRODUCTION
+#define PRODUCTION_MODE true
+#else
+extern bool production_mode;
+#define PRODUCTION_MODE production_mode
+#endif
+
+#define REQUEST_LOG(...) do { if (!PRODUCTION_MODE) printf(__VA_ARGS__); } while (0)
+
 #endif /* DEBUG_H */ 
\ No newline at end of file
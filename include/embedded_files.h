@@ -0,0 +1,46 @@
+#ifndef EMBEDDED_FILES_H
+#define EMBEDDED_FILES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "compression.h"
+
+/*
+ * The web root compiled into the binary by tools/embed_www.c when built
+ * with BLINK_EMBED_WWW. Paths are relative to the root and start with
+ * '/'. Static assets carry their compressed variants and ETags, worked
+ * out at build time. Pages carry only their source, because they are
+ * rendered per request. Lookups take full paths under the web root and
+ * go through a hash-and-displace perfect hash: two XXH64 passes and one
+ * string compare.
+ */
+typedef struct {
+    const char* path;
+    const unsigned char* data;
+    size_t size;
+    time_t mtime;
+    const char* etag;
+    const unsigned char* variants[ENCODING_COUNT];
+    size_t variant_sizes[ENCODING_COUNT];
+    const char* variant_etags[ENCODING_COUNT];
+} embedded_file_t;
+
+typedef struct {
+    const embedded_file_t* files;
+    size_t file_count;
+    const uint32_t* seeds;
+    size_t bucket_count;
+    const int32_t* slots;
+    size_t slot_count;
+} embedded_table_t;
+
+extern const embedded_table_t embedded_www;
+
+bool embedded_root_path(const char* path);
+const embedded_file_t* find_embedded_file(const char* path);
+size_t embedded_file_count(void);
+const embedded_file_t* embedded_file_at(size_t index);
+
+#endif
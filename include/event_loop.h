@@ -0,0 +1,167 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include <sys/socket.h>
+#include "request_handler.h"
+#include "http_parser.h"
+#include "websocket.h"
+#include "worker_pool.h"
+#include "mpmc_queue.h"
+#include "timer_wheel.h"
+#include "coroutine.h"
+
+#define MAX_EVENTS 256
+#define ACCEPT_BATCH 64
+#define LOOP_TICK_MS 100
+#define REQUEST_BUFFER_SIZE (BUFFER_SIZE * 4)
+#define MAX_REQUEST_SIZE (1024 * 1024)
+#define CONN_HEADER_TIMEOUT_MS 5000
+#define CONN_BODY_TIMEOUT_MS 30000
+#define CONN_WRITE_TIMEOUT_MS 30000
+#define CONN_IDLE_TIMEOUT_MS (KEEPALIVE_TIMEOUT_SEC * 1000)
+#define WS_PING_INTERVAL_MS 5000
+#define RELOAD_DELAY_MS 300
+#define RELOAD_COOLDOWN_MS 1000
+#define DRAIN_TIMEOUT_MS 30000
+#define COMPLETION_QUEUE_SIZE (WORKER_QUEUE_SIZE + MAX_WORKERS)
+
+#define SERVICE_UNAVAILABLE_RESPONSE "HTTP/1.1 503 Service Unavailable\r\n" \
+                                     "Content-Type: text/html\r\n" \
+                                     "Retry-After: 1\r\n" \
+                                     "Content-Length: 32\r\n" \
+                                     "Connection: close\r\n" \
+                                     "\r\n" \
+                                     "<h1>503 Service Unavailable</h1>"
+
+#define TOO_MANY_REQUESTS_RESPONSE "HTTP/1.1 429 Too Many Requests\r\n" \
+                                   "Content-Type: text/html\r\n" \
+                                   "Retry-After: 1\r\n" \
+                                   "Content-Length: 30\r\n" \
+                                   "Connection: close\r\n" \
+                                   "\r\n" \
+                                   "<h1>429 Too Many Requests</h1>"
+
+#define BAD_REQUEST_RESPONSE "HTTP/1.1 400 Bad Request\r\n" \
+                             "Content-Type: text/html\r\n" \
+                             "Content-Length: 24\r\n" \
+                             "Connection: close\r\n" \
+                             "\r\n" \
+                             "<h1>400 Bad Request</h1>"
+
+#define PAYLOAD_TOO_LARGE_RESPONSE "HTTP/1.1 413 Payload Too Large\r\n" \
+                                   "Content-Type: text/html\r\n" \
+                                   "Content-Length: 30\r\n" \
+                                   "Connection: close\r\n" \
+                                   "\r\n" \
+                                   "<h1>413 Payload Too Large</h1>"
+
+#define LENGTH_REQUIRED_RESPONSE "HTTP/1.1 411 Length Required\r\n" \
+                                 "Content-Type: text/html\r\n" \
+                                 "Content-Length: 28\r\n" \
+                                 "Connection: close\r\n" \
+                                 "\r\n" \
+                                 "<h1>411 Length Required</h1>"
+
+typedef enum {
+    CONN_READING,
+    CONN_RENDERING,
+    CONN_WRITING,
+    CONN_WEBSOCKET
+} conn_state_t;
+
+typedef enum {
+    DEADLINE_NONE,
+    DEADLINE_IDLE,
+    DEADLINE_HEADER,
+    DEADLINE_BODY,
+    DEADLINE_WRITE
+} deadline_t;
+
+typedef enum {
+    LOOP_BACKEND_EPOLL,
+    LOOP_BACKEND_IO_URING
+} loop_backend_t;
+
+struct event_loop;
+struct uring_backend;
+
+typedef struct {
+    int fd;
+    conn_state_t state;
+    struct event_loop* owner;
+    bool close_pending;
+    bool closed;
+    int pending_ops;
+    char* buffer;
+    size_t buffer_len;
+    size_t buffer_cap;
+    http_request_t request;
+    size_t request_len;
+    int requests_served;
+    bool keep_alive;
+    http_response_t response;
+    size_t response_sent;
+    struct iovec send_iov[RESPONSE_MAX_IOVS];
+    struct msghdr send_msg;
+    bool corked;
+    timer_node_t deadline;
+    deadline_t deadline_kind;
+    bool admitted;
+    long long queued_us;
+    uint64_t peer_key;
+    coroutine_t* coroutine;
+    blocking_fn blocking;
+    void* blocking_arg;
+} connection_t;
+
+typedef struct event_loop {
+    loop_backend_t backend;
+    struct uring_backend* uring;
+    int epoll_fd;
+    int listen_fd;
+    int watch_fd;
+    int notify_fd;
+    worker_pool_t* workers;
+    mpmc_queue_t completions;
+    const char* watch_dir;
+    ws_clients_t* ws_clients;
+    connection_t** conns;
+    int conns_capacity;
+    int active_conns;
+    bool accept_pending;
+    timer_wheel_t timers;
+    timer_node_t ping_timer;
+    timer_node_t reload_timer;
+    timer_node_t fd_cache_timer;
+    long long last_reload_ms;
+    bool draining;
+    long long drain_deadline;
+    coroutine_pool_t coroutines;
+} event_loop_t;
+
+event_loop_t* init_event_loop(int listen_fd, int watch_fd, const char* watch_dir,
+                              ws_clients_t* clients, worker_pool_t* workers);
+void process_connection_job(void* job);
+void run_event_loop(event_loop_t* loop, volatile sig_atomic_t* running, volatile sig_atomic_t* draining);
+void free_event_loop(event_loop_t* loop);
+
+long long now_ms(void);
+connection_t* register_connection(event_loop_t* loop, int fd, const struct sockaddr* peer);
+bool refuse_rate_limited(event_loop_t* loop, connection_t* conn);
+bool grow_connection_buffer(connection_t* conn);
+void set_connection_cork(connection_t* conn, bool enable);
+bool connection_data_received(event_loop_t* loop, connection_t* conn);
+bool handle_websocket_readable(event_loop_t* loop, connection_t* conn);
+bool complete_response(event_loop_t* loop, connection_t* conn);
+void close_connection(event_loop_t* loop, connection_t* conn);
+void release_connection(connection_t* conn);
+void drain_completions(event_loop_t* loop);
+void handle_file_events(event_loop_t* loop);
+int next_timer_timeout(event_loop_t* loop);
+void run_timers(event_loop_t* loop);
+bool check_drain(event_loop_t* loop, bool draining);
+
+#endif
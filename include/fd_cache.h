@@ -0,0 +1,49 @@
+#ifndef FD_CACHE_H
+#define FD_CACHE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+#define FD_CACHE_MAX_ENTRIES 256
+#define FD_CACHE_BUCKETS 64
+#define FD_CACHE_IDLE_SEC 30
+#define FD_CACHE_SWEEP_MS 1000
+
+/*
+ * Open descriptors for static assets, with the size and mtime fstat()
+ * reported when they were opened, so a hot file is sent without any
+ * open/fstat/close. Bounded by entry count and by an idle timeout. The
+ * file watcher invalidates entries as inotify reports changes. Entries
+ * are reference counted and the descriptor is closed with the last
+ * reference, so a response can keep sending from an evicted entry.
+ * With the cache disabled fd_cache_open() still returns an entry, just
+ * one that is never shared.
+ */
+typedef struct fd_cache_entry {
+    char* path;
+    uint64_t hash;
+    int fd;
+    size_t size;
+    time_t mtime;
+    bool cached;
+    atomic_int refs;
+    long long last_used_ms;
+    struct fd_cache_entry* hash_next;
+    struct fd_cache_entry* lru_prev;
+    struct fd_cache_entry* lru_next;
+} fd_cache_entry_t;
+
+int init_fd_cache(int max_entries, int idle_sec);
+fd_cache_entry_t* fd_cache_lookup(const char* path);
+fd_cache_entry_t* fd_cache_open(const char* path);
+void fd_cache_release(fd_cache_entry_t* entry);
+void fd_cache_invalidate(const char* path);
+void fd_cache_clear(void);
+void expire_fd_cache(void);
+int format_fd_cache_stats(char* buffer, size_t size);
+void free_fd_cache(void);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef FILE_CACHE_H
+#define FILE_CACHE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "compression.h"
+
+#define FILE_CACHE_SHARDS 16
+#define FILE_CACHE_BUCKETS 64
+#define FILE_CACHE_BUDGET_MB 32
+
+typedef enum {
+    VARIANTS_NONE,
+    VARIANTS_PENDING,
+    VARIANTS_READY
+} variant_state_t;
+
+/*
+ * File contents keyed by path, so repeated requests never touch the
+ * disk. Paths that do not exist are cached too. The file watcher
+ * invalidates entries as inotify reports changes. Each shard has its
+ * own lock, LRU list and 1/FILE_CACHE_SHARDS of the byte budget.
+ * Entries are reference counted, so a reader can keep using one after
+ * it has been evicted or invalidated.
+ *
+ * A page entry may also hold its rendered output, and any entry may
+ * hold compressed copies of its body. Both are set once, under the
+ * shard lock, before variant_state moves past VARIANTS_NONE, and they
+ * go away with the entry when the file changes.
+ */
+typedef struct file_cache_entry {
+    char* path;
+    uint64_t hash;
+    char* data;
+    size_t size;
+    time_t mtime;
+    uint64_t data_hash;
+    bool missing;
+    bool cached;
+    atomic_int refs;
+    char* rendered;
+    size_t rendered_size;
+    uint64_t rendered_hash;
+    atomic_int variant_state;
+    char* variants[ENCODING_COUNT];
+    size_t variant_sizes[ENCODING_COUNT];
+    struct file_cache_entry* hash_next;
+    struct file_cache_entry* lru_prev;
+    struct file_cache_entry* lru_next;
+} file_cache_entry_t;
+
+int init_file_cache(size_t budget_bytes);
+file_cache_entry_t* file_cache_lookup(const char* path);
+file_cache_entry_t* file_cache_load(const char* path);
+bool file_cache_fits(const char* path, size_t size);
+void file_cache_release(file_cache_entry_t* entry);
+bool file_cache_attach_rendered(file_cache_entry_t* entry, char* body, size_t size);
+void file_cache_attach_variants(file_cache_entry_t* entry, char** variants, const size_t* sizes);
+void file_cache_invalidate(const char* path);
+void file_cache_clear(void);
+int format_file_cache_stats(char* buffer, size_t size);
+void free_file_cache(void);
+
+#endif
@@ -2,27 +2,22 @@
 #define FILE_WATCHER_H
 
 #include <sys/inotify.h>
-#include <pthread.h>
 #include <stdbool.h>
 #include <time.h>
 
 #define EVENT_SIZE (sizeof(struct inotify_event))
 #define BUF_LEN (1024 * (EVENT_SIZE + 16))
+#define WATCH_MASK (IN_MODIFY | IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB | \
+                    IN_DELETE | IN_MOVED_FROM)
+#define WATCH_MAX_DIRS 256
 
 typedef struct {
     char* path;
     time_t last_modified;
 } file_info_t;
 
-typedef struct {
-    char* directory;
-    bool* file_changed;
-    pthread_mutex_t* mutex;
-} watcher_args_t;
-
-int init_file_watcher(const char* directory, bool* file_changed, pthread_mutex_t* mutex);
-pthread_t start_file_watcher(const char* directory, bool* file_changed, pthread_mutex_t* mutex);
-bool file_has_changed(const char* filename, time_t* last_modified);
-void* watch_files(void* args);
+int init_file_watcher(const char* directory);
+bool process_file_events(int watch_fd, const char* directory);
+void close_file_watcher(int watch_fd);
 
-#endif
\ No newline at end of file
+#endif
@@ -1,11 +1,15 @@
 #ifndef HTML_SERVE_H
 #define HTML_SERVE_H
 
+#include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "file_cache.h"
 
+file_cache_entry_t* load_cached_file(const char* filename);
 char* serve_html(const char* filename);
-char* inject_hot_reload_js(char* html_content);
+bool html_file_exists(const char* filename);
+const char* get_hot_reload_js(size_t* length);
 
 #endif
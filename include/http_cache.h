@@ -0,0 +1,27 @@
+#ifndef HTTP_CACHE_H
+#define HTTP_CACHE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+#include "http_parser.h"
+
+#define ETAG_SIZE 40
+#define HTTP_DATE_SIZE 32
+
+/*
+ * Validators for conditional GET. Cached pages and files carry an
+ * XXH64 hash of their body, and the ETag is that hash plus a suffix
+ * for the content encoding. Files streamed from disk without being
+ * read use "size-mtime" instead. Disabled unless --cache is given.
+ */
+void configure_http_cache(bool enabled);
+bool http_cache_enabled(void);
+uint64_t xxh64(const void* data, size_t length, uint64_t seed);
+void format_etag(char* buffer, size_t size, uint64_t hash, const char* suffix);
+void format_file_etag(char* buffer, size_t size, size_t length, time_t mtime);
+void format_http_date(char* buffer, size_t size, time_t when);
+bool request_not_modified(const http_request_t* request, const char* etag, time_t mtime);
+
+#endif
@@ -0,0 +1,47 @@
+#ifndef HTTP_PARSER_H
+#define HTTP_PARSER_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define HTTP_MAX_HEADERS 64
+
+typedef struct {
+    const char* data;
+    size_t len;
+} http_slice_t;
+
+typedef struct {
+    http_slice_t name;
+    http_slice_t value;
+} http_header_t;
+
+/*
+ * Request view over the connection buffer. Slices point into the buffer that
+ * was last passed to parse_http_request and are only valid while it is.
+ */
+typedef struct {
+    http_slice_t method;
+    http_slice_t path;
+    http_slice_t query;
+    http_slice_t body;
+    int minor_version;
+    http_header_t headers[HTTP_MAX_HEADERS];
+    int header_count;
+    size_t header_len;
+    size_t content_length;
+    bool chunked;
+    const char* base;
+    size_t scan_offset;
+} http_request_t;
+
+void init_http_request(http_request_t* request);
+int parse_http_request(http_request_t* request, const char* buffer, size_t length);
+size_t http_request_length(const http_request_t* request);
+const http_slice_t* find_http_header(const http_request_t* request, const char* name);
+bool http_header_has_token(const http_request_t* request, const char* name, const char* token);
+bool http_header_accepts(const http_request_t* request, const char* name, const char* token);
+bool http_slice_equals(http_slice_t slice, const char* text);
+int http_slice_copy(http_slice_t slice, char* out, size_t out_size);
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef HTTP_RANGE_H
+#define HTTP_RANGE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include "http_parser.h"
+
+#define RANGE_MAX_PARTS 16
+#define RANGE_MULTIPART_MAX (1024 * 1024)
+#define RANGE_BOUNDARY_SIZE 32
+
+typedef enum {
+    RANGE_NONE,
+    RANGE_SATISFIABLE,
+    RANGE_UNSATISFIABLE
+} range_result_t;
+
+typedef struct {
+    size_t start;
+    size_t length;
+} byte_range_t;
+
+/*
+ * Byte ranges of static files. One range becomes a 206 whose body is a
+ * sendfile() window of the file. Several become multipart/byteranges,
+ * which is assembled in memory and limited to RANGE_MAX_PARTS parts and
+ * RANGE_MULTIPART_MAX bytes. A larger request, a malformed Range header
+ * or a failed If-Range gets the whole file, as RFC 7233 allows.
+ * read_multipart_ranges() reads with pread(), so callers run it off the
+ * event loop.
+ */
+range_result_t parse_byte_ranges(const http_request_t* request, size_t size, byte_range_t* ranges, int* count);
+bool if_range_matches(const http_request_t* request, const char* etag, time_t mtime);
+void format_range_boundary(char* buffer, size_t size);
+char* read_multipart_ranges(int fd, size_t size, const byte_range_t* ranges, int count,
+                            const char* content_type, const char* boundary, size_t* length);
+
+#endif
@@ -0,0 +1,61 @@
+#ifndef HTTP_RESPONSE_H
+#define HTTP_RESPONSE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#define KEEPALIVE_TIMEOUT_SEC 15
+#define KEEPALIVE_MAX_REQUESTS 100
+
+#define RESPONSE_HEAD_IOVS 4
+#define RESPONSE_MAX_IOVS 12
+#define RESPONSE_MAX_OWNED 4
+#define RESPONSE_HEAD_SIZE 256
+#define RESPONSE_EXTRA_HEADERS_SIZE 512
+
+/*
+ * Scatter-gather response: rendered status line, cached header block,
+ * per-response headers, connection block and borrowed body segments, all
+ * sent with one sendmsg(). Buffers handed over with http_response_own()
+ * are freed with the response. An optional file segment follows the
+ * iovecs and is sent with sendfile(); the descriptor is borrowed, so the
+ * caller holds whatever owns it. A held object, such as the cache entry
+ * that owns the body bytes or the descriptor, is released with the
+ * response.
+ */
+typedef void (*http_release_fn)(void* object);
+
+typedef struct {
+    struct iovec iov[RESPONSE_MAX_IOVS];
+    int iov_count;
+    char* owned[RESPONSE_MAX_OWNED];
+    int owned_count;
+    char head[RESPONSE_HEAD_SIZE];
+    char extra_headers[RESPONSE_EXTRA_HEADERS_SIZE];
+    size_t extra_len;
+    size_t body_length;
+    size_t length;
+    int file_fd;
+    off_t file_offset;
+    size_t file_length;
+    void* held;
+    http_release_fn release_held;
+    bool keep_alive;
+} http_response_t;
+
+void init_http_response(http_response_t* response, bool keep_alive);
+int http_response_add_header(http_response_t* response, const char* name, const char* value);
+int http_response_add_body(http_response_t* response, const char* data, size_t length);
+int http_response_own(http_response_t* response, char* buffer);
+int http_response_hold(http_response_t* response, void* object, http_release_fn release);
+int http_response_add_file(http_response_t* response, int fd, off_t offset, size_t length);
+int finish_http_response(http_response_t* response, const char* status, const char* headers);
+void http_response_drop_body(http_response_t* response);
+void set_static_http_response(http_response_t* response, const char* data);
+int http_response_pending_iov(const http_response_t* response, size_t sent, struct iovec* out);
+ssize_t http_response_send_file(const http_response_t* response, int socket, size_t sent);
+void free_http_response(http_response_t* response);
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef MINIFY_H
+#define MINIFY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/*
+ * Whitespace and comment stripping for HTML pages, run once when the
+ * file cache reads a page. Whitespace runs collapse to one character
+ * (a newline if the run had one) and comments are dropped, except
+ * conditional ones and template directives. <pre>, <textarea>,
+ * <script> and <style> bodies, quoted attribute values and template
+ * tags are copied unchanged. minify_html() works in place and needs
+ * room for a terminator.
+ */
+void configure_minify(bool enabled);
+bool minify_applies(const char* path);
+size_t minify_html(char* html, size_t length);
+
+#endif
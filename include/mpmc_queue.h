@@ -0,0 +1,34 @@
+#ifndef MPMC_QUEUE_H
+#define MPMC_QUEUE_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#define CACHE_LINE_SIZE 64
+
+/*
+ * Bounded lock-free multi-producer/multi-consumer queue (Vyukov).
+ * Capacity is rounded up to a power of two; push fails when full.
+ */
+typedef struct {
+    atomic_size_t sequence;
+    void* data;
+} mpmc_cell_t;
+
+typedef struct {
+    mpmc_cell_t* cells;
+    size_t mask;
+    char pad0[CACHE_LINE_SIZE];
+    atomic_size_t enqueue_pos;
+    char pad1[CACHE_LINE_SIZE];
+    atomic_size_t dequeue_pos;
+    char pad2[CACHE_LINE_SIZE];
+} mpmc_queue_t;
+
+int init_mpmc_queue(mpmc_queue_t* queue, size_t capacity);
+bool mpmc_queue_push(mpmc_queue_t* queue, void* data);
+void* mpmc_queue_pop(mpmc_queue_t* queue);
+void free_mpmc_queue(mpmc_queue_t* queue);
+
+#endif
@@ -0,0 +1,28 @@
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+typedef enum {
+    PLACEMENT_LOOP,
+    PLACEMENT_WORKER,
+    PLACEMENT_HOUSEKEEPING,
+    PLACEMENT_ROLES
+} placement_role_t;
+
+/*
+ * CPU sets for each class of thread. Event loops get one CPU each,
+ * round-robin over their set; workers and housekeeping float within
+ * theirs. Every placed thread also switches to MPOL_LOCAL so its
+ * allocations come from the NUMA node it runs on. Sets left unset
+ * default to the process affinity minus the housekeeping CPUs.
+ */
+int configure_placement(placement_role_t role, const char* cpu_list);
+int init_placement(void);
+bool placement_configured(placement_role_t role);
+int placement_cpu(placement_role_t role, int index);
+int place_thread(placement_role_t role, int cpu);
+int format_placement(placement_role_t role, char* buffer, size_t size);
+
+#endif
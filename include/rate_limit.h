@@ -0,0 +1,44 @@
+#ifndef RATE_LIMIT_H
+#define RATE_LIMIT_H
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define RATE_LIMIT_SHARDS 64
+#define RATE_LIMIT_SHARD_SLOTS 64
+#define RATE_LIMIT_PROBES 8
+
+typedef enum {
+    RATE_LIMIT_HTTP,
+    RATE_LIMIT_WEBSOCKET,
+    RATE_LIMIT_KINDS
+} rate_limit_kind_t;
+
+/*
+ * One token bucket per client address. The key and the packed state
+ * (milli-tokens << 32 | last refill in ms) are updated with CAS, so the
+ * event loops share the table without locks. A slot is only reclaimed
+ * once its bucket has refilled completely, so eviction never forgives a
+ * client. When every probed slot is taken the request is allowed.
+ */
+typedef struct {
+    atomic_uint_fast64_t key;
+    atomic_uint_fast64_t state;
+} rate_bucket_t;
+
+typedef struct {
+    rate_bucket_t buckets[RATE_LIMIT_SHARDS][RATE_LIMIT_SHARD_SLOTS];
+    uint64_t rate;
+    uint64_t burst;
+    atomic_llong rejected;
+} rate_limiter_t;
+
+void configure_rate_limit(rate_limit_kind_t kind, int rate, int burst);
+bool rate_limit_enabled(rate_limit_kind_t kind);
+bool rate_limit_allow(rate_limit_kind_t kind, uint64_t key);
+bool rate_limit_exhausted(rate_limit_kind_t kind, uint64_t key);
+int format_rate_limit_stats(char* buffer, size_t size);
+
+#endif
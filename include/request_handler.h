@@ -10,15 +10,21 @@
 #include "websocket.h"
 #include "server.h"
 #include "sqlite_handler.h"
+#include "http_parser.h"
+#include "http_response.h"
 
 #define BUFFER_SIZE 1024
 
 extern ws_clients_t* ws_clients;
 extern bool enable_templates;
 
-void handle_client(int new_socket);
-void handle_websocket_client(int new_socket, ws_clients_t* clients);
-int is_websocket_request(const char* buffer);
+void build_http_response(const http_request_t* request, bool allow_keep_alive,
+                         http_response_t* response);
+int handle_websocket_upgrade(int new_socket, const http_request_t* request, ws_clients_t* clients);
+int is_websocket_request(const http_request_t* request);
+void set_stats_endpoint(bool enabled);
+bool is_stats_request(const http_request_t* request);
+void build_stats_response(bool allow_keep_alive, http_response_t* response);
 bool has_template_features(const char* content);
 void set_template_settings(bool enabled);
 void set_custom_html_file(const char* file_path);
@@ -0,0 +1,34 @@
+#ifndef ROUTE_TABLE_H
+#define ROUTE_TABLE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define ROUTE_BUCKETS 256
+#define ROUTE_MAX_DEPTH 8
+
+typedef struct route_entry {
+    char* url;
+    char* file;
+    uint64_t hash;
+    struct route_entry* next;
+} route_entry_t;
+
+/*
+ * URL path to page file, built from a scan of the web root and kept
+ * current by the file watcher, so resolving a request never touches the
+ * filesystem. A page answers to its path with and without ".html", and
+ * index.html also answers for its directory with and without the
+ * trailing slash. Readers share a rwlock with the watcher.
+ */
+int init_route_table(const char* root);
+bool resolve_route(const char* url, size_t url_len, char* file, size_t file_size);
+void route_file_added(const char* file);
+void route_file_removed(const char* file);
+void route_directory_added(const char* directory);
+void route_directory_removed(const char* directory);
+void rebuild_route_table(void);
+void free_route_table(void);
+
+#endif
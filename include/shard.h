@@ -0,0 +1,36 @@
+#ifndef SHARD_H
+#define SHARD_H
+
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include "event_loop.h"
+
+#define MAX_SHARDS 256
+// TCP shards plus the --unix listener
+#define MAX_LISTENERS (MAX_SHARDS + 1)
+
+typedef struct {
+    int index;
+    int cpu;
+    int listen_fd;
+    event_loop_t* loop;
+    pthread_t thread;
+    bool thread_started;
+    volatile sig_atomic_t* running;
+    volatile sig_atomic_t* draining;
+} shard_t;
+
+typedef struct {
+    shard_t* shards;
+    int count;
+    bool pinned;
+} shard_set_t;
+
+shard_set_t* init_shards(int count, int port, const int* listen_fds, int unix_fd, bool use_cbpf,
+                         int watch_fd, const char* watch_dir, ws_clients_t* clients,
+                         worker_pool_t* workers);
+void run_shards(shard_set_t* set, volatile sig_atomic_t* running, volatile sig_atomic_t* draining);
+void free_shards(shard_set_t* set);
+
+#endif
@@ -1,18 +1,26 @@
 #ifndef SOCKET_UTILS_H
 #define SOCKET_UTILS_H
 
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
+#include <sys/un.h>
 #include <asm-generic/socket.h>
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
+#define DEFER_ACCEPT_SEC 0
 
+void configure_listen_sockets(int backlog, int defer_accept_sec);
+int tune_listener(int server_fd);
 int initialize_server(struct sockaddr_in* address);
+int initialize_unix_server(const char* path);
+int attach_reuseport_cbpf(int server_fd);
+uint64_t peer_address_key(const struct sockaddr* address);
 void read_client_data(int socket, char* buffer);
 
 #endif
@@ -0,0 +1,22 @@
+#ifndef STATIC_FILES_H
+#define STATIC_FILES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "fd_cache.h"
+
+/*
+ * Non-HTML files under the web root. Only extensions with a known MIME
+ * type are served, so databases and other working files stay private.
+ * Descriptors come from the fd cache, opened on a worker on a miss, and
+ * the response streams them with sendfile(). Text-like types
+ * are marked compressible and may be answered from the file cache
+ * with a compressed variant instead.
+ */
+const char* get_content_type(const char* path);
+const char* static_asset_headers(const char* path);
+bool static_asset_compressible(const char* path);
+int static_asset_path(const char* root, const char* path, char* out, size_t size);
+fd_cache_entry_t* open_static_asset(const char* root, const char* path);
+
+#endif
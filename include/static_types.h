@@ -0,0 +1,33 @@
+#ifndef STATIC_TYPES_H
+#define STATIC_TYPES_H
+
+/*
+ * Extension, MIME type and whether it compresses well, for every static
+ * asset type that is served. Expanded by static_files.c and by the
+ * build-time web root embedder, so both agree on what is public.
+ */
+#define STATIC_TYPES(X) \
+    X(".css", "text/css; charset=UTF-8", true)               \
+    X(".js", "application/javascript; charset=UTF-8", true)  \
+    X(".mjs", "application/javascript; charset=UTF-8", true) \
+    X(".json", "application/json", true)                     \
+    X(".map", "application/json", true)                      \
+    X(".txt", "text/plain; charset=UTF-8", true)             \
+    X(".xml", "application/xml", true)                       \
+    X(".png", "image/png", false)                            \
+    X(".jpg", "image/jpeg", false)                           \
+    X(".jpeg", "image/jpeg", false)                          \
+    X(".gif", "image/gif", false)                            \
+    X(".webp", "image/webp", false)                          \
+    X(".svg", "image/svg+xml", true)                         \
+    X(".ico", "image/x-icon", true)                          \
+    X(".woff", "font/woff", false)                           \
+    X(".woff2", "font/woff2", false)                         \
+    X(".ttf", "font/ttf", true)                              \
+    X(".wasm", "application/wasm", true)                     \
+    X(".pdf", "application/pdf", false)                      \
+    X(".mp4", "video/mp4", false)                            \
+    X(".webm", "video/webm", false)                          \
+    X(".mp3", "audio/mpeg", false)
+
+#endif
@@ -0,0 +1,44 @@
+#ifndef TIMER_WHEEL_H
+#define TIMER_WHEEL_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TIMER_WHEEL_LEVELS 4
+#define TIMER_WHEEL_BITS 6
+#define TIMER_WHEEL_SLOTS (1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_MASK (TIMER_WHEEL_SLOTS - 1)
+
+typedef void (*timer_fn)(void* data);
+
+/*
+ * Intrusive timer, embedded in the object it belongs to. Slots are circular
+ * lists, so arming and cancelling are O(1).
+ */
+typedef struct timer_node {
+    struct timer_node* prev;
+    struct timer_node* next;
+    uint64_t expires;
+    timer_fn callback;
+    void* data;
+} timer_node_t;
+
+/*
+ * Hierarchical wheel with 1 ms ticks: level 0 covers 64 ms, each further
+ * level 64 times the previous one. Timers cascade down as time advances.
+ */
+typedef struct {
+    timer_node_t slots[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+    uint64_t now;
+    int count;
+} timer_wheel_t;
+
+void init_timer_wheel(timer_wheel_t* wheel, uint64_t now_ms);
+void init_timer(timer_node_t* timer, timer_fn callback, void* data);
+void timer_arm(timer_wheel_t* wheel, timer_node_t* timer, uint64_t expires_ms);
+void timer_cancel(timer_wheel_t* wheel, timer_node_t* timer);
+bool timer_pending(const timer_node_t* timer);
+void advance_timer_wheel(timer_wheel_t* wheel, uint64_t now_ms);
+int timer_wheel_next_timeout(const timer_wheel_t* wheel, int max_ms);
+
+#endif
@@ -0,0 +1,21 @@
+#ifndef UPGRADE_H
+#define UPGRADE_H
+
+#include <sys/types.h>
+
+#define LISTEN_FDS_ENV "BLINK_LISTEN_FDS"
+#define UPGRADE_PARENT_ENV "BLINK_UPGRADE_PID"
+
+/*
+ * Hot upgrade: SIGUSR2 re-executes the binary with the listening sockets
+ * inherited through LISTEN_FDS_ENV. Once the new process has its event
+ * loops running it sends SIGQUIT to the old one, which stops accepting
+ * and drains. The sockets never close, so no connection is refused.
+ */
+int take_inherited_listeners(int* fds, int max);
+int prepare_upgrade(char* argv[], const int* fds, int count);
+pid_t spawn_upgrade(void);
+void notify_upgrade_parent(void);
+void free_upgrade(void);
+
+#endif
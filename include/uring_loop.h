@@ -0,0 +1,19 @@
+#ifndef URING_LOOP_H
+#define URING_LOOP_H
+
+#include <signal.h>
+#include "event_loop.h"
+
+#define URING_ENTRIES 1024
+#define URING_BUFFER_COUNT 512
+#define URING_BUFFER_SIZE REQUEST_BUFFER_SIZE
+#define URING_BUFFER_GROUP 0
+
+int init_uring_backend(event_loop_t* loop);
+void run_uring_loop(event_loop_t* loop, volatile sig_atomic_t* running, volatile sig_atomic_t* draining);
+void uring_stop_accept(event_loop_t* loop);
+void uring_submit_send(event_loop_t* loop, connection_t* conn);
+void uring_watch_websocket(event_loop_t* loop, connection_t* conn);
+void free_uring_backend(event_loop_t* loop);
+
+#endif
@@ -6,11 +6,14 @@
 #include <string.h>
 #include <unistd.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <sys/socket.h>
 #include <pthread.h>
+#include "http_parser.h"
 
 #define MAX_CLIENTS 50
 #define BUFFER_SIZE 1024
+#define WS_MAX_PAYLOAD (64 * 1024)
 #define WS_HANDSHAKE_KEY "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
 #define WS_RESPONSE "HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\nSec-WebSocket-Accept: %s\r\n\r\n"
 
@@ -33,18 +36,20 @@
 
 typedef struct {
     int client_sockets[MAX_CLIENTS];
+    uint64_t client_keys[MAX_CLIENTS];
+    char client_names[MAX_CLIENTS][64];
     int count;
     pthread_mutex_t mutex;
 } ws_clients_t;
 
 ws_clients_t* init_ws_clients();
-void add_ws_client(ws_clients_t* clients, int socket_fd);
+int add_ws_client(ws_clients_t* clients, int socket_fd);
 void remove_ws_client(ws_clients_t* clients, int socket_fd);
 bool is_client_connected(int socket_fd);
-int process_ws_handshake(int client_socket, char* buffer);
+int process_ws_handshake(int client_socket, const http_request_t* request);
 int send_ws_frame(int client_socket, const char* message, size_t length, int opcode);
 void broadcast_to_ws_clients(ws_clients_t* clients, const char* message);
-void handle_ws_connection(int client_socket, ws_clients_t* clients);
+int process_ws_frame(int client_socket, const unsigned char* data, size_t length);
 void free_ws_clients(ws_clients_t* clients);
 
 #endif
\ No newline at end of file
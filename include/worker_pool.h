@@ -0,0 +1,30 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include "mpmc_queue.h"
+#include "placement.h"
+
+#define WORKER_QUEUE_SIZE 1024
+#define MAX_WORKERS 256
+
+typedef void (*worker_job_fn)(void* job);
+
+typedef struct {
+    pthread_t* threads;
+    int thread_count;
+    mpmc_queue_t jobs;
+    sem_t jobs_available;
+    worker_job_fn handler;
+    placement_role_t role;
+    atomic_bool running;
+} worker_pool_t;
+
+worker_pool_t* init_worker_pool(int thread_count, worker_job_fn handler, placement_role_t role);
+bool submit_worker_job(worker_pool_t* pool, void* job);
+void free_worker_pool(worker_pool_t* pool);
+
+#endif
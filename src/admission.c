@@ -0,0 +1,122 @@
+#include "admission.h"
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+
+typedef struct {
+    atomic_llong average_us;
+    atomic_llong last_sample_us;
+} latency_average_t;
+
+static int max_inflight = ADMISSION_MAX_INFLIGHT;
+static long long max_queue_wait_us = ADMISSION_MAX_QUEUE_WAIT_MS * 1000LL;
+static long long max_db_busy_us = ADMISSION_MAX_DB_BUSY_MS * 1000LL;
+
+static atomic_int inflight;
+static atomic_llong decisions[ADMISSION_DECISIONS];
+static latency_average_t queue_wait;
+static latency_average_t db_busy;
+
+static const char* decision_names[ADMISSION_DECISIONS] = {
+    "admitted",
+    "shed_inflight",
+    "shed_queue_wait",
+    "shed_db_busy",
+    "shed_queue_full"
+};
+
+long long monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000LL + ts.tv_nsec / 1000;
+}
+
+// An average halves for every ADMISSION_SAMPLE_TTL_MS without samples
+static long long decayed(long long average, long long idle_us) {
+    long long periods = idle_us / (ADMISSION_SAMPLE_TTL_MS * 1000LL);
+    return periods >= 63 ? 0 : average >> periods;
+}
+
+static void record_sample(latency_average_t* average, long long sample_us) {
+    long long now = monotonic_us();
+    long long current = atomic_load_explicit(&average->average_us, memory_order_relaxed);
+    long long last = atomic_load_explicit(&average->last_sample_us, memory_order_relaxed);
+
+    current = decayed(current, now - last);
+    current += (sample_us - current) / 8;
+    atomic_store_explicit(&average->average_us, current, memory_order_relaxed);
+    atomic_store_explicit(&average->last_sample_us, now, memory_order_relaxed);
+}
+
+static long long current_average(latency_average_t* average, long long now) {
+    long long last = atomic_load_explicit(&average->last_sample_us, memory_order_relaxed);
+    return decayed(atomic_load_explicit(&average->average_us, memory_order_relaxed), now - last);
+}
+
+void configure_admission(int inflight_limit, int queue_wait_ms, int db_busy_ms) {
+    max_inflight = inflight_limit;
+    max_queue_wait_us = queue_wait_ms * 1000LL;
+    max_db_busy_us = db_busy_ms * 1000LL;
+}
+
+admission_decision_t admit_request(void) {
+    admission_decision_t decision = ADMIT_OK;
+    long long now = monotonic_us();
+
+    if (max_inflight > 0 && atomic_load_explicit(&inflight, memory_order_relaxed) >= max_inflight) {
+        decision = SHED_INFLIGHT;
+    } else if (max_queue_wait_us > 0 && current_average(&queue_wait, now) > max_queue_wait_us) {
+        decision = SHED_QUEUE_WAIT;
+    }
+
+    if (decision == ADMIT_OK) {
+        atomic_fetch_add_explicit(&inflight, 1, memory_order_relaxed);
+    }
+    atomic_fetch_add_explicit(&decisions[decision], 1, memory_order_relaxed);
+    return decision;
+}
+
+bool admit_query(void) {
+    if (max_db_busy_us > 0 && current_average(&db_busy, monotonic_us()) > max_db_busy_us) {
+        record_shed(SHED_DB_BUSY);
+        return false;
+    }
+    return true;
+}
+
+void finish_admitted_request(void) {
+    atomic_fetch_sub_explicit(&inflight, 1, memory_order_relaxed);
+}
+
+void record_shed(admission_decision_t reason) {
+    atomic_fetch_add_explicit(&decisions[reason], 1, memory_order_relaxed);
+}
+
+void record_queue_wait(long long wait_us) {
+    record_sample(&queue_wait, wait_us);
+}
+
+void record_db_busy(long long busy_us) {
+    record_sample(&db_busy, busy_us);
+}
+
+int format_admission_stats(char* buffer, size_t size) {
+    long long now = monotonic_us();
+    int written = snprintf(buffer, size, "inflight %d\n",
+                           atomic_load_explicit(&inflight, memory_order_relaxed));
+
+    for (int i = 0; i < ADMISSION_DECISIONS && written >= 0 && (size_t)written < size; i++) {
+        written += snprintf(buffer + written, size - written, "%s %lld\n", decision_names[i],
+                            atomic_load_explicit(&decisions[i], memory_order_relaxed));
+    }
+    if (written >= 0 && (size_t)written < size) {
+        written += snprintf(buffer + written, size - written,
+                            "queue_wait_avg_us %lld\ndb_busy_avg_us %lld\n",
+                            current_average(&queue_wait, now), current_average(&db_busy, now));
+    }
+
+    if (written < 0 || (size_t)written >= size) {
+        return -1;
+    }
+    return written;
+}
@@ -0,0 +1,160 @@
+#include "compression.h"
+#include "file_cache.h"
+#include "placement.h"
+#include "websocket.h"
+#include "worker_pool.h"
+#include <stdlib.h>
+#include <zlib.h>
+#ifdef BLINK_BROTLI
+#include <brotli/encode.h>
+#endif
+
+static worker_pool_t* compressor = NULL;
+static bool enabled = false;
+
+static const char* encoding_tokens[ENCODING_COUNT] = { "br", "gzip" };
+static const char* encoding_extensions[ENCODING_COUNT] = { ".br", ".gz" };
+
+static char* compress_gzip(const char* data, size_t length, size_t* out_length) {
+    z_stream stream = {0};
+    if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 15 + 16, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+
+    size_t bound = deflateBound(&stream, length);
+    char* out = malloc(bound);
+    if (!out) {
+        deflateEnd(&stream);
+        return NULL;
+    }
+
+    stream.next_in = (Bytef*)data;
+    stream.avail_in = length;
+    stream.next_out = (Bytef*)out;
+    stream.avail_out = bound;
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        deflateEnd(&stream);
+        free(out);
+        return NULL;
+    }
+
+    *out_length = stream.total_out;
+    deflateEnd(&stream);
+    return out;
+}
+
+#ifdef BLINK_BROTLI
+static char* compress_brotli(const char* data, size_t length, size_t* out_length) {
+    size_t bound = BrotliEncoderMaxCompressedSize(length);
+    char* out = bound ? malloc(bound) : NULL;
+    if (!out) {
+        return NULL;
+    }
+
+    *out_length = bound;
+    if (!BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT, length,
+                               (const uint8_t*)data, out_length, (uint8_t*)out)) {
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+#endif
+
+static char* compress_variant(content_encoding_t encoding, const char* data, size_t length, size_t* out_length) {
+    switch (encoding) {
+        case ENCODING_GZIP:
+            return compress_gzip(data, length, out_length);
+#ifdef BLINK_BROTLI
+        case ENCODING_BROTLI:
+            return compress_brotli(data, length, out_length);
+#endif
+        default:
+            return NULL;
+    }
+}
+
+static void run_compression_job(void* job) {
+    file_cache_entry_t* entry = (file_cache_entry_t*)job;
+    const char* source = entry->rendered ? entry->rendered : entry->data;
+    size_t length = entry->rendered ? entry->rendered_size : entry->size;
+    char* variants[ENCODING_COUNT] = {0};
+    size_t sizes[ENCODING_COUNT] = {0};
+
+    for (int i = 0; i < ENCODING_COUNT && source && length >= COMPRESS_MIN_SIZE; i++) {
+        variants[i] = compress_variant((content_encoding_t)i, source, length, &sizes[i]);
+        // Not worth a Content-Encoding if it barely shrinks
+        if (variants[i] && sizes[i] >= length - length / 16) {
+            free(variants[i]);
+            variants[i] = NULL;
+        }
+    }
+
+    file_cache_attach_variants(entry, variants, sizes);
+    file_cache_release(entry);
+}
+
+int init_compression(bool enable) {
+    enabled = enable;
+    if (!enabled) {
+        return 0;
+    }
+
+    compressor = init_worker_pool(1, run_compression_job, PLACEMENT_HOUSEKEEPING);
+    if (!compressor) {
+        enabled = false;
+        return -1;
+    }
+
+    printf("%s%s[COMPRESSION] %sBuilding gzip%s variants in the background%s\n",
+           BOLD, COLOR_BLUE, COLOR_GREEN, encoding_supported(ENCODING_BROTLI) ? " and brotli" : "", COLOR_RESET);
+    return 0;
+}
+
+bool compression_enabled(void) {
+    return enabled;
+}
+
+bool encoding_supported(content_encoding_t encoding) {
+#ifdef BLINK_BROTLI
+    return encoding < ENCODING_COUNT;
+#else
+    return encoding == ENCODING_GZIP;
+#endif
+}
+
+const char* encoding_token(content_encoding_t encoding) {
+    return encoding_tokens[encoding];
+}
+
+const char* encoding_extension(content_encoding_t encoding) {
+    return encoding_extensions[encoding];
+}
+
+bool schedule_compression(file_cache_entry_t* entry) {
+    int expected = VARIANTS_NONE;
+    if (!atomic_compare_exchange_strong(&entry->variant_state, &expected, VARIANTS_PENDING)) {
+        return false;
+    }
+
+    if (!enabled || (entry->rendered ? entry->rendered_size : entry->size) > COMPRESS_MAX_SIZE) {
+        char* none[ENCODING_COUNT] = {0};
+        size_t sizes[ENCODING_COUNT] = {0};
+        file_cache_attach_variants(entry, none, sizes);
+        return true;
+    }
+
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    if (!submit_worker_job(compressor, entry)) {
+        atomic_store(&entry->variant_state, VARIANTS_NONE);
+        file_cache_release(entry);
+        return false;
+    }
+    return true;
+}
+
+void free_compression(void) {
+    free_worker_pool(compressor);
+    compressor = NULL;
+    enabled = false;
+}
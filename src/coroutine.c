@@ -0,0 +1,108 @@
+#include "coroutine.h"
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static __thread coroutine_t* current_coroutine = NULL;
+
+static size_t guard_size(void) {
+    long page = sysconf(_SC_PAGESIZE);
+    return page > 0 ? (size_t)page : 4096;
+}
+
+static void coroutine_entry(void) {
+    coroutine_t* co = current_coroutine;
+    co->fn(co->arg);
+    co->finished = true;
+}
+
+static void destroy_coroutine(coroutine_t* co) {
+    munmap(co->stack, COROUTINE_STACK_SIZE);
+    free(co);
+}
+
+coroutine_t* create_coroutine(coroutine_pool_t* pool, coroutine_fn fn, void* arg, offload_fn offload) {
+    coroutine_t* co = pool->free_list;
+    size_t guard = guard_size();
+
+    if (co) {
+        pool->free_list = co->next;
+        pool->free_count--;
+    } else {
+        co = malloc(sizeof(coroutine_t));
+        if (!co) {
+            return NULL;
+        }
+
+        co->stack = mmap(NULL, COROUTINE_STACK_SIZE, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+        if (co->stack == MAP_FAILED) {
+            free(co);
+            return NULL;
+        }
+        mprotect(co->stack, guard, PROT_NONE);
+    }
+
+    if (getcontext(&co->context) != 0) {
+        destroy_coroutine(co);
+        return NULL;
+    }
+    co->context.uc_stack.ss_sp = co->stack + guard;
+    co->context.uc_stack.ss_size = COROUTINE_STACK_SIZE - guard;
+    co->context.uc_link = &co->caller;
+    makecontext(&co->context, coroutine_entry, 0);
+
+    co->fn = fn;
+    co->arg = arg;
+    co->offload = offload;
+    co->finished = false;
+    co->shed = false;
+    co->next = NULL;
+    return co;
+}
+
+bool resume_coroutine(coroutine_t* co) {
+    coroutine_t* previous = current_coroutine;
+    current_coroutine = co;
+    swapcontext(&co->caller, &co->context);
+    current_coroutine = previous;
+    return co->finished;
+}
+
+void release_coroutine(coroutine_pool_t* pool, coroutine_t* co) {
+    if (!co) {
+        return;
+    }
+
+    if (pool->free_count >= COROUTINE_POOL_MAX) {
+        destroy_coroutine(co);
+        return;
+    }
+    co->next = pool->free_list;
+    pool->free_list = co;
+    pool->free_count++;
+}
+
+void free_coroutine_pool(coroutine_pool_t* pool) {
+    while (pool->free_list) {
+        coroutine_t* co = pool->free_list;
+        pool->free_list = co->next;
+        destroy_coroutine(co);
+    }
+    pool->free_count = 0;
+}
+
+bool run_blocking(blocking_fn fn, void* arg) {
+    coroutine_t* co = current_coroutine;
+    if (!co || !co->offload) {
+        fn(arg);
+        return true;
+    }
+
+    if (co->shed || !co->offload(co, fn, arg)) {
+        co->shed = true;
+        return false;
+    }
+    swapcontext(&co->context, &co->caller);
+    return true;
+}
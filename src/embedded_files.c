@@ -0,0 +1,33 @@
+#include "embedded_files.h"
+#include "http_cache.h"
+#include "server.h"
+#include <string.h>
+
+#define EMBED_ROOT_LEN (sizeof(HTML_DIR) - 1)
+
+bool embedded_root_path(const char* path) {
+    return strncmp(path, HTML_DIR, EMBED_ROOT_LEN) == 0 && path[EMBED_ROOT_LEN] == '/';
+}
+
+const embedded_file_t* find_embedded_file(const char* path) {
+    if (!embedded_root_path(path)) {
+        return NULL;
+    }
+
+    const char* relative = path + EMBED_ROOT_LEN;
+    size_t length = strlen(relative);
+    uint32_t seed = embedded_www.seeds[xxh64(relative, length, 0) % embedded_www.bucket_count];
+    int32_t index = embedded_www.slots[xxh64(relative, length, seed) % embedded_www.slot_count];
+    if (index < 0 || strcmp(embedded_www.files[index].path, relative) != 0) {
+        return NULL;
+    }
+    return &embedded_www.files[index];
+}
+
+size_t embedded_file_count(void) {
+    return embedded_www.file_count;
+}
+
+const embedded_file_t* embedded_file_at(size_t index) {
+    return index < embedded_www.file_count ? &embedded_www.files[index] : NULL;
+}
@@ -0,0 +1,886 @@
+#define _GNU_SOURCE
+#include "event_loop.h"
+#include "admission.h"
+#include "rate_limit.h"
+#include "file_watcher.h"
+#include "fd_cache.h"
+#include "debug.h"
+#ifdef BLINK_IO_URING
+#include "uring_loop.h"
+#endif
+#include <errno.h>
+#include <fcntl.h>
+#include <netinet/tcp.h>
+#include <sched.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+static void handle_readable(event_loop_t* loop, connection_t* conn);
+
+long long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int set_non_blocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    if (flags == -1 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) == -1) {
+        fprintf(stderr, "%s%s[ERROR] %sfcntl O_NONBLOCK failed: %s%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+        return -1;
+    }
+    return 0;
+}
+
+static int add_to_epoll(event_loop_t* loop, int fd, uint32_t events) {
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.fd = fd;
+    if (epoll_ctl(loop->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        fprintf(stderr, "%s%s[ERROR] %sepoll_ctl failed for fd %d: %s%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, fd, strerror(errno), COLOR_RESET);
+        return -1;
+    }
+    return 0;
+}
+
+static int ensure_conn_capacity(event_loop_t* loop, int fd) {
+    if (fd < loop->conns_capacity) {
+        return 0;
+    }
+
+    int new_capacity = loop->conns_capacity;
+    while (new_capacity <= fd) {
+        new_capacity *= 2;
+    }
+
+    connection_t** new_conns = realloc(loop->conns, new_capacity * sizeof(connection_t*));
+    if (!new_conns) {
+        return -1;
+    }
+
+    memset(new_conns + loop->conns_capacity, 0,
+           (new_capacity - loop->conns_capacity) * sizeof(connection_t*));
+    loop->conns = new_conns;
+    loop->conns_capacity = new_capacity;
+    return 0;
+}
+
+static void connection_deadline_expired(void* data) {
+    connection_t* conn = (connection_t*)data;
+    if (conn->deadline_kind == DEADLINE_HEADER || conn->deadline_kind == DEADLINE_BODY) {
+        REQUEST_LOG("%s%s[HTTP] %sClosing connection %d: request not received in time%s\n",
+                    BOLD, COLOR_YELLOW, COLOR_RESET, conn->fd, COLOR_RESET);
+    }
+    conn->deadline_kind = DEADLINE_NONE;
+    close_connection(conn->owner, conn);
+}
+
+static void arm_deadline(event_loop_t* loop, connection_t* conn, deadline_t kind) {
+    int timeout_ms;
+    switch (kind) {
+        case DEADLINE_IDLE:
+            timeout_ms = CONN_IDLE_TIMEOUT_MS;
+            break;
+        case DEADLINE_HEADER:
+            timeout_ms = CONN_HEADER_TIMEOUT_MS;
+            break;
+        case DEADLINE_BODY:
+            timeout_ms = CONN_BODY_TIMEOUT_MS;
+            break;
+        case DEADLINE_WRITE:
+            timeout_ms = CONN_WRITE_TIMEOUT_MS;
+            break;
+        default:
+            timer_cancel(&loop->timers, &conn->deadline);
+            conn->deadline_kind = DEADLINE_NONE;
+            return;
+    }
+
+    conn->deadline_kind = kind;
+    timer_arm(&loop->timers, &conn->deadline, now_ms() + timeout_ms);
+}
+
+void release_connection(connection_t* conn) {
+    release_coroutine(&conn->owner->coroutines, conn->coroutine);
+    free_http_response(&conn->response);
+    free(conn->buffer);
+    free(conn);
+}
+
+static void release_admission(connection_t* conn) {
+    if (conn->admitted) {
+        conn->admitted = false;
+        finish_admitted_request();
+    }
+}
+
+void close_connection(event_loop_t* loop, connection_t* conn) {
+    release_admission(conn);
+    if (conn->state == CONN_WEBSOCKET) {
+        remove_ws_client(loop->ws_clients, conn->fd);
+    }
+
+    timer_cancel(&loop->timers, &conn->deadline);
+    loop->conns[conn->fd] = NULL;
+    loop->active_conns--;
+
+    if (conn->pending_ops > 0) {
+        shutdown(conn->fd, SHUT_RDWR);
+        close(conn->fd);
+        conn->closed = true;
+        return;
+    }
+
+    close(conn->fd);
+    release_connection(conn);
+}
+
+connection_t* register_connection(event_loop_t* loop, int fd, const struct sockaddr* peer) {
+    connection_t* conn = NULL;
+    if (ensure_conn_capacity(loop, fd) == 0) {
+        conn = malloc(sizeof(connection_t));
+    }
+    if (conn) {
+        conn->buffer = malloc(REQUEST_BUFFER_SIZE);
+        if (!conn->buffer) {
+            free(conn);
+            conn = NULL;
+        }
+    }
+    if (!conn) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to allocate connection state%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+        close(fd);
+        return NULL;
+    }
+
+    conn->fd = fd;
+    conn->state = CONN_READING;
+    conn->owner = loop;
+    conn->close_pending = false;
+    conn->closed = false;
+    conn->pending_ops = 0;
+    conn->buffer[0] = '\0';
+    conn->buffer_len = 0;
+    conn->buffer_cap = REQUEST_BUFFER_SIZE;
+    init_http_request(&conn->request);
+    conn->request_len = 0;
+    conn->requests_served = 0;
+    conn->keep_alive = true;
+    init_http_response(&conn->response, false);
+    conn->response_sent = 0;
+    conn->corked = false;
+    conn->admitted = false;
+    conn->queued_us = 0;
+    conn->peer_key = 0;
+    conn->coroutine = NULL;
+    if (peer) {
+        conn->peer_key = peer_address_key(peer);
+    } else if (rate_limit_enabled(RATE_LIMIT_HTTP) || rate_limit_enabled(RATE_LIMIT_WEBSOCKET)) {
+        struct sockaddr_storage address;
+        socklen_t len = sizeof(address);
+        if (getpeername(fd, (struct sockaddr*)&address, &len) == 0) {
+            conn->peer_key = peer_address_key((struct sockaddr*)&address);
+        }
+    }
+    init_timer(&conn->deadline, connection_deadline_expired, conn);
+    arm_deadline(loop, conn, DEADLINE_HEADER);
+
+    int nodelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &nodelay, sizeof(nodelay));
+
+    loop->conns[fd] = conn;
+    loop->active_conns++;
+    return conn;
+}
+
+static void accept_connections(event_loop_t* loop) {
+    // Bounded so a connection storm cannot starve established clients
+    loop->accept_pending = false;
+    for (int accepted = 0; !loop->draining; accepted++) {
+        if (accepted == ACCEPT_BATCH) {
+            loop->accept_pending = true;
+            return;
+        }
+
+        struct sockaddr_storage peer;
+        socklen_t peer_len = sizeof(peer);
+        int fd = accept4(loop->listen_fd, (struct sockaddr*)&peer, &peer_len, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fprintf(stderr, "%s%s[ERROR] %sConnection not accepted: %s%s\n",
+                        BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+            }
+            return;
+        }
+
+        connection_t* conn = register_connection(loop, fd, (struct sockaddr*)&peer);
+        if (!conn) {
+            continue;
+        }
+
+        if (add_to_epoll(loop, fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET) < 0) {
+            close_connection(loop, conn);
+            continue;
+        }
+        refuse_rate_limited(loop, conn);
+    }
+}
+
+bool grow_connection_buffer(connection_t* conn) {
+    if (conn->buffer_cap >= MAX_REQUEST_SIZE) {
+        return false;
+    }
+
+    size_t new_cap = conn->buffer_cap * 2;
+    char* new_buffer = realloc(conn->buffer, new_cap);
+    if (!new_buffer) {
+        return false;
+    }
+
+    conn->buffer = new_buffer;
+    conn->buffer_cap = new_cap;
+    return true;
+}
+
+void set_connection_cork(connection_t* conn, bool enable) {
+    if (conn->corked == enable) {
+        return;
+    }
+
+    int value = enable ? 1 : 0;
+    setsockopt(conn->fd, IPPROTO_TCP, TCP_CORK, &value, sizeof(value));
+    conn->corked = enable;
+}
+
+static void handle_writable(event_loop_t* loop, connection_t* conn) {
+    size_t head_length = conn->response.length - conn->response.file_length;
+
+    while (conn->response_sent < conn->response.length) {
+        ssize_t sent;
+        if (conn->response_sent < head_length) {
+            struct msghdr msg;
+            memset(&msg, 0, sizeof(msg));
+            msg.msg_iov = conn->send_iov;
+            msg.msg_iovlen = http_response_pending_iov(&conn->response, conn->response_sent, conn->send_iov);
+            sent = sendmsg(conn->fd, &msg, MSG_NOSIGNAL | (conn->response.file_length ? MSG_MORE : 0));
+        } else {
+            sent = http_response_send_file(&conn->response, conn->fd, conn->response_sent);
+        }
+
+        if (sent > 0) {
+            conn->response_sent += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            set_connection_cork(conn, true);
+            return;
+        }
+        close_connection(loop, conn);
+        return;
+    }
+
+    if (complete_response(loop, conn)) {
+        handle_readable(loop, conn);
+    }
+}
+
+bool complete_response(event_loop_t* loop, connection_t* conn) {
+    if (!conn->response.keep_alive) {
+        close_connection(loop, conn);
+        return false;
+    }
+
+    release_admission(conn);
+    set_connection_cork(conn, false);
+    free_http_response(&conn->response);
+    conn->response_sent = 0;
+
+    size_t leftover = conn->buffer_len - conn->request_len;
+    memmove(conn->buffer, conn->buffer + conn->request_len, leftover);
+    conn->buffer_len = leftover;
+    conn->buffer[leftover] = '\0';
+    init_http_request(&conn->request);
+    conn->request_len = 0;
+    conn->keep_alive = true;
+    conn->state = CONN_READING;
+    arm_deadline(loop, conn, leftover > 0 ? DEADLINE_HEADER : DEADLINE_IDLE);
+    return true;
+}
+
+static void finish_rendering(event_loop_t* loop, connection_t* conn) {
+    if (conn->close_pending || conn->response.length == 0) {
+        close_connection(loop, conn);
+        return;
+    }
+
+    conn->state = CONN_WRITING;
+    conn->response_sent = 0;
+    arm_deadline(loop, conn, DEADLINE_WRITE);
+#ifdef BLINK_IO_URING
+    if (loop->backend == LOOP_BACKEND_IO_URING) {
+        uring_submit_send(loop, conn);
+        return;
+    }
+#endif
+    handle_writable(loop, conn);
+}
+
+static void run_handler(void* arg) {
+    connection_t* conn = (connection_t*)arg;
+    build_http_response(&conn->request, conn->keep_alive, &conn->response);
+}
+
+static bool offload_blocking(coroutine_t* co, blocking_fn fn, void* arg) {
+    connection_t* conn = (connection_t*)co->arg;
+    event_loop_t* loop = conn->owner;
+
+    conn->blocking = fn;
+    conn->blocking_arg = arg;
+    conn->queued_us = monotonic_us();
+    return submit_worker_job(loop->workers, conn);
+}
+
+static void resume_handler(event_loop_t* loop, connection_t* conn) {
+    if (!resume_coroutine(conn->coroutine)) {
+        return;
+    }
+
+    bool shed = conn->coroutine->shed;
+    release_coroutine(&loop->coroutines, conn->coroutine);
+    conn->coroutine = NULL;
+    if (shed) {
+        fprintf(stderr, "%s%s[WORKERS] %sJob queue full, rejecting request%s\n",
+                BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+        release_admission(conn);
+        record_shed(SHED_QUEUE_FULL);
+        free_http_response(&conn->response);
+        set_static_http_response(&conn->response, SERVICE_UNAVAILABLE_RESPONSE);
+    }
+    finish_rendering(loop, conn);
+}
+
+void process_connection_job(void* job) {
+    connection_t* conn = (connection_t*)job;
+    event_loop_t* loop = conn->owner;
+
+    record_queue_wait(monotonic_us() - conn->queued_us);
+    conn->blocking(conn->blocking_arg);
+
+    while (!mpmc_queue_push(&loop->completions, conn)) {
+        sched_yield();
+    }
+
+    uint64_t one = 1;
+    if (write(loop->notify_fd, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to signal event loop: %s%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+    }
+}
+
+void drain_completions(event_loop_t* loop) {
+    uint64_t count;
+    while (read(loop->notify_fd, &count, sizeof(count)) > 0) {
+    }
+
+    connection_t* conn;
+    while ((conn = mpmc_queue_pop(&loop->completions)) != NULL) {
+        resume_handler(loop, conn);
+    }
+}
+
+static void reject_request(event_loop_t* loop, connection_t* conn, const char* response) {
+    conn->state = CONN_RENDERING;
+    set_static_http_response(&conn->response, response);
+    finish_rendering(loop, conn);
+}
+
+bool refuse_rate_limited(event_loop_t* loop, connection_t* conn) {
+    if (!rate_limit_exhausted(RATE_LIMIT_HTTP, conn->peer_key)) {
+        return false;
+    }
+
+    reject_request(loop, conn, TOO_MANY_REQUESTS_RESPONSE);
+    return true;
+}
+
+static void dispatch_request(event_loop_t* loop, connection_t* conn) {
+    if (is_websocket_request(&conn->request)) {
+        if (!rate_limit_allow(RATE_LIMIT_WEBSOCKET, conn->peer_key)) {
+            reject_request(loop, conn, TOO_MANY_REQUESTS_RESPONSE);
+        } else if (!loop->draining && handle_websocket_upgrade(conn->fd, &conn->request, loop->ws_clients) == 0) {
+            conn->state = CONN_WEBSOCKET;
+            // Frames the client sent right behind the handshake are handled, not dropped
+            size_t leftover = conn->buffer_len - conn->request_len;
+            memmove(conn->buffer, conn->buffer + conn->request_len, leftover);
+            conn->buffer_len = leftover;
+            arm_deadline(loop, conn, DEADLINE_NONE);
+            if (!handle_websocket_readable(loop, conn)) {
+                return;
+            }
+#ifdef BLINK_IO_URING
+            if (loop->backend == LOOP_BACKEND_IO_URING) {
+                uring_watch_websocket(loop, conn);
+            }
+#endif
+        } else {
+            close_connection(loop, conn);
+        }
+        return;
+    }
+
+    arm_deadline(loop, conn, DEADLINE_NONE);
+    conn->requests_served++;
+    if (conn->requests_served >= KEEPALIVE_MAX_REQUESTS || loop->draining) {
+        conn->keep_alive = false;
+    }
+
+    conn->state = CONN_RENDERING;
+    if (is_stats_request(&conn->request)) {
+        build_stats_response(conn->keep_alive, &conn->response);
+        finish_rendering(loop, conn);
+        return;
+    }
+
+    if (!rate_limit_allow(RATE_LIMIT_HTTP, conn->peer_key)) {
+        reject_request(loop, conn, TOO_MANY_REQUESTS_RESPONSE);
+        return;
+    }
+
+    if (admit_request() != ADMIT_OK) {
+        reject_request(loop, conn, SERVICE_UNAVAILABLE_RESPONSE);
+        return;
+    }
+    conn->admitted = true;
+
+    if (loop->workers) {
+        conn->coroutine = create_coroutine(&loop->coroutines, run_handler, conn, offload_blocking);
+        if (conn->coroutine) {
+            resume_handler(loop, conn);
+            return;
+        }
+    }
+
+    build_http_response(&conn->request, conn->keep_alive, &conn->response);
+    finish_rendering(loop, conn);
+}
+
+static void handle_readable(event_loop_t* loop, connection_t* conn) {
+    for (;;) {
+        if (conn->buffer_len >= conn->buffer_cap - 1 && !grow_connection_buffer(conn)) {
+            break;
+        }
+
+        ssize_t bytes_read = recv(conn->fd, conn->buffer + conn->buffer_len,
+                                  conn->buffer_cap - 1 - conn->buffer_len, 0);
+        if (bytes_read > 0) {
+            conn->buffer_len += bytes_read;
+            conn->buffer[conn->buffer_len] = '\0';
+            continue;
+        }
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            break;
+        }
+        close_connection(loop, conn);
+        return;
+    }
+
+    connection_data_received(loop, conn);
+}
+
+bool connection_data_received(event_loop_t* loop, connection_t* conn) {
+    int parsed = parse_http_request(&conn->request, conn->buffer, conn->buffer_len);
+    if (parsed < 0) {
+        reject_request(loop, conn, BAD_REQUEST_RESPONSE);
+        return false;
+    }
+
+    if (parsed == 0) {
+        bool too_large = conn->buffer_len >= MAX_REQUEST_SIZE - 1 ||
+                         (conn->request.header_len > 0 &&
+                          http_request_length(&conn->request) >= MAX_REQUEST_SIZE);
+        if (too_large) {
+            reject_request(loop, conn, PAYLOAD_TOO_LARGE_RESPONSE);
+            return false;
+        }
+
+        if (conn->request.header_len > 0 && conn->deadline_kind != DEADLINE_BODY) {
+            arm_deadline(loop, conn, DEADLINE_BODY);
+        } else if (conn->deadline_kind == DEADLINE_IDLE && conn->buffer_len > 0) {
+            arm_deadline(loop, conn, DEADLINE_HEADER);
+        }
+        return true;
+    }
+
+    // Chunked bodies are not decoded, so the client is asked for a Content-Length instead
+    if (conn->request.chunked) {
+        reject_request(loop, conn, LENGTH_REQUIRED_RESPONSE);
+        return false;
+    }
+
+    conn->request_len = http_request_length(&conn->request);
+
+    dispatch_request(loop, conn);
+    return false;
+}
+
+bool handle_websocket_readable(event_loop_t* loop, connection_t* conn) {
+    for (;;) {
+        // A frame split across reads stays buffered until the rest arrives
+        size_t used = 0;
+        int frame;
+        while ((frame = process_ws_frame(conn->fd, (const unsigned char*)conn->buffer + used,
+                                         conn->buffer_len - used)) > 0) {
+            used += frame;
+        }
+        if (frame < 0) {
+            close_connection(loop, conn);
+            return false;
+        }
+        memmove(conn->buffer, conn->buffer + used, conn->buffer_len - used);
+        conn->buffer_len -= used;
+
+        if (conn->buffer_len >= conn->buffer_cap - 1 && !grow_connection_buffer(conn)) {
+            close_connection(loop, conn);
+            return false;
+        }
+
+        ssize_t bytes_read = recv(conn->fd, conn->buffer + conn->buffer_len,
+                                  conn->buffer_cap - 1 - conn->buffer_len, MSG_DONTWAIT);
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            return true;
+        }
+        if (bytes_read <= 0) {
+            close_connection(loop, conn);
+            return false;
+        }
+        conn->buffer_len += bytes_read;
+    }
+}
+
+static void send_ping(void* data) {
+    event_loop_t* loop = (event_loop_t*)data;
+    if (loop->ws_clients && loop->ws_clients->count > 0) {
+        broadcast_to_ws_clients(loop->ws_clients, "ping");
+    }
+    timer_arm(&loop->timers, &loop->ping_timer, loop->timers.now + WS_PING_INTERVAL_MS);
+}
+
+static void send_reload(void* data) {
+    event_loop_t* loop = (event_loop_t*)data;
+    loop->last_reload_ms = now_ms();
+    if (loop->ws_clients && loop->ws_clients->count > 0) {
+        printf("%s%s[HOT RELOAD] %sNotifying %s%d%s client(s) to reload%s\n",
+               BOLD, COLOR_MAGENTA, COLOR_RESET,
+               COLOR_YELLOW, loop->ws_clients->count, COLOR_RESET, COLOR_RESET);
+        broadcast_to_ws_clients(loop->ws_clients, "reload");
+        printf("%s%s[HOT RELOAD] %s%sReload notification sent successfully%s\n",
+               BOLD, COLOR_MAGENTA, BOLD, COLOR_GREEN, COLOR_RESET);
+    } else {
+        printf("%s%s[HOT RELOAD] %sNo clients connected, skipping notification%s\n",
+               BOLD, COLOR_MAGENTA, COLOR_YELLOW, COLOR_RESET);
+    }
+}
+
+static void sweep_fd_cache(void* data) {
+    event_loop_t* loop = (event_loop_t*)data;
+    expire_fd_cache();
+    timer_arm(&loop->timers, &loop->fd_cache_timer, loop->timers.now + FD_CACHE_SWEEP_MS);
+}
+
+static void schedule_reload(event_loop_t* loop) {
+    long long now = now_ms();
+    if (timer_pending(&loop->reload_timer)) {
+        return;
+    }
+
+    long long earliest = loop->last_reload_ms + RELOAD_COOLDOWN_MS;
+    if (loop->last_reload_ms != 0 && now < earliest) {
+        printf("%s%s[HOT RELOAD] %sChanges detected during cooldown period (%dms), deferring%s\n",
+               BOLD, COLOR_MAGENTA, COLOR_YELLOW, RELOAD_COOLDOWN_MS, COLOR_RESET);
+        timer_arm(&loop->timers, &loop->reload_timer, earliest + RELOAD_DELAY_MS);
+    } else {
+        printf("%s%s[HOT RELOAD] %sFile changes detected, preparing notification%s\n",
+               BOLD, COLOR_MAGENTA, COLOR_RESET, COLOR_RESET);
+        timer_arm(&loop->timers, &loop->reload_timer, now + RELOAD_DELAY_MS);
+    }
+}
+
+void handle_file_events(event_loop_t* loop) {
+    // Production still drains inotify so the file cache stays current
+    if (process_file_events(loop->watch_fd, loop->watch_dir) && !PRODUCTION_MODE) {
+        schedule_reload(loop);
+    }
+}
+
+int next_timer_timeout(event_loop_t* loop) {
+    return timer_wheel_next_timeout(&loop->timers, LOOP_TICK_MS);
+}
+
+void run_timers(event_loop_t* loop) {
+    advance_timer_wheel(&loop->timers, now_ms());
+}
+
+static void start_draining(event_loop_t* loop) {
+    loop->draining = true;
+    loop->drain_deadline = now_ms() + DRAIN_TIMEOUT_MS;
+
+#ifdef BLINK_IO_URING
+    if (loop->backend == LOOP_BACKEND_IO_URING) {
+        uring_stop_accept(loop);
+    }
+#endif
+    if (loop->epoll_fd >= 0) {
+        epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, loop->listen_fd, NULL);
+    }
+
+    for (int fd = 0; fd < loop->conns_capacity; fd++) {
+        connection_t* conn = loop->conns[fd];
+        if (!conn) {
+            continue;
+        }
+
+        if (conn->state == CONN_WEBSOCKET) {
+            send_ws_frame(conn->fd, "", 0, WS_CLOSE);
+            close_connection(loop, conn);
+        } else if (conn->state == CONN_READING && conn->deadline_kind == DEADLINE_IDLE) {
+            close_connection(loop, conn);
+        }
+    }
+
+    if (loop->active_conns > 0) {
+        printf("%s%s[DRAIN] %sStopped accepting, waiting for %s%d%s in-flight connection(s)%s\n",
+               BOLD, COLOR_BLUE, COLOR_RESET, COLOR_YELLOW, loop->active_conns, COLOR_RESET, COLOR_RESET);
+    }
+}
+
+bool check_drain(event_loop_t* loop, bool draining) {
+    if (draining && !loop->draining) {
+        start_draining(loop);
+    }
+    if (!loop->draining) {
+        return false;
+    }
+    if (loop->active_conns > 0 && now_ms() >= loop->drain_deadline) {
+        fprintf(stderr, "%s%s[DRAIN] %sDrain timeout, dropping %d connection(s)%s\n",
+                BOLD, COLOR_YELLOW, COLOR_RESET, loop->active_conns, COLOR_RESET);
+        return true;
+    }
+    return loop->active_conns == 0;
+}
+
+event_loop_t* init_event_loop(int listen_fd, int watch_fd, const char* watch_dir,
+                              ws_clients_t* clients, worker_pool_t* workers) {
+    event_loop_t* loop = calloc(1, sizeof(event_loop_t));
+    if (!loop) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to allocate event loop%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+        return NULL;
+    }
+
+    loop->epoll_fd = -1;
+    loop->notify_fd = -1;
+    loop->listen_fd = listen_fd;
+    loop->watch_fd = watch_fd;
+    loop->watch_dir = watch_dir;
+    loop->ws_clients = clients;
+    loop->workers = workers;
+    loop->conns_capacity = 1024;
+    loop->conns = calloc(loop->conns_capacity, sizeof(connection_t*));
+    loop->backend = LOOP_BACKEND_EPOLL;
+    init_timer_wheel(&loop->timers, now_ms());
+    init_timer(&loop->ping_timer, send_ping, loop);
+    init_timer(&loop->reload_timer, send_reload, loop);
+    init_timer(&loop->fd_cache_timer, sweep_fd_cache, loop);
+    if (watch_fd >= 0) {
+        timer_arm(&loop->timers, &loop->ping_timer, now_ms() + WS_PING_INTERVAL_MS);
+        timer_arm(&loop->timers, &loop->fd_cache_timer, now_ms() + FD_CACHE_SWEEP_MS);
+    }
+    loop->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    if (!loop->conns || loop->notify_fd < 0 ||
+        init_mpmc_queue(&loop->completions, COMPLETION_QUEUE_SIZE) != 0) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to create event loop: %s%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+        free_event_loop(loop);
+        return NULL;
+    }
+
+    if (set_non_blocking(listen_fd) < 0) {
+        free_event_loop(loop);
+        return NULL;
+    }
+
+#ifdef BLINK_IO_URING
+    if (init_uring_backend(loop) == 0) {
+        loop->backend = LOOP_BACKEND_IO_URING;
+        return loop;
+    }
+#endif
+
+    loop->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (loop->epoll_fd < 0) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to create epoll instance: %s%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+        free_event_loop(loop);
+        return NULL;
+    }
+
+    if (add_to_epoll(loop, listen_fd, EPOLLIN | EPOLLET) < 0) {
+        free_event_loop(loop);
+        return NULL;
+    }
+
+    if (watch_fd >= 0 && add_to_epoll(loop, watch_fd, EPOLLIN | EPOLLET) < 0) {
+        free_event_loop(loop);
+        return NULL;
+    }
+
+    if (add_to_epoll(loop, loop->notify_fd, EPOLLIN | EPOLLET) < 0) {
+        free_event_loop(loop);
+        return NULL;
+    }
+
+    return loop;
+}
+
+void run_event_loop(event_loop_t* loop, volatile sig_atomic_t* running, volatile sig_atomic_t* draining) {
+    struct epoll_event events[MAX_EVENTS];
+
+#ifdef BLINK_IO_URING
+    if (loop->backend == LOOP_BACKEND_IO_URING) {
+        run_uring_loop(loop, running, draining);
+        return;
+    }
+#endif
+
+    while (*running && !check_drain(loop, *draining)) {
+        int timeout = loop->accept_pending ? 0 : next_timer_timeout(loop);
+        int ready = epoll_wait(loop->epoll_fd, events, MAX_EVENTS, timeout);
+        if (!*running) {
+            break;
+        }
+
+        if (ready < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            fprintf(stderr, "%s%s[ERROR] %sepoll_wait error: %s%s\n",
+                    BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+            break;
+        }
+
+        for (int i = 0; i < ready; i++) {
+            int fd = events[i].data.fd;
+            uint32_t mask = events[i].events;
+
+            if (fd == loop->listen_fd) {
+                accept_connections(loop);
+                continue;
+            }
+
+            if (fd == loop->notify_fd) {
+                drain_completions(loop);
+                continue;
+            }
+
+            if (fd == loop->watch_fd) {
+                handle_file_events(loop);
+                continue;
+            }
+
+            connection_t* conn = fd < loop->conns_capacity ? loop->conns[fd] : NULL;
+            if (!conn) {
+                continue;
+            }
+
+            if (conn->state == CONN_RENDERING) {
+                if (mask & (EPOLLERR | EPOLLHUP)) {
+                    conn->close_pending = true;
+                }
+                continue;
+            }
+
+            if (mask & (EPOLLERR | EPOLLHUP)) {
+                close_connection(loop, conn);
+                continue;
+            }
+
+            switch (conn->state) {
+                case CONN_READING:
+                    if (mask & (EPOLLIN | EPOLLRDHUP)) {
+                        handle_readable(loop, conn);
+                    }
+                    break;
+                case CONN_WRITING:
+                    if (mask & EPOLLOUT) {
+                        handle_writable(loop, conn);
+                    }
+                    break;
+                case CONN_WEBSOCKET:
+                    if (mask & (EPOLLIN | EPOLLRDHUP)) {
+                        handle_websocket_readable(loop, conn);
+                    }
+                    break;
+                default:
+                    break;
+            }
+        }
+
+        if (loop->accept_pending) {
+            accept_connections(loop);
+        }
+        run_timers(loop);
+    }
+}
+
+void free_event_loop(event_loop_t* loop) {
+    if (!loop) {
+        return;
+    }
+
+#ifdef BLINK_IO_URING
+    if (loop->backend == LOOP_BACKEND_IO_URING) {
+        free_uring_backend(loop);
+    }
+#endif
+
+    if (loop->conns) {
+        for (int fd = 0; fd < loop->conns_capacity; fd++) {
+            if (loop->conns[fd]) {
+                loop->conns[fd]->pending_ops = 0;
+                close_connection(loop, loop->conns[fd]);
+            }
+        }
+        free(loop->conns);
+    }
+
+    if (loop->epoll_fd >= 0) {
+        close(loop->epoll_fd);
+    }
+
+    if (loop->notify_fd >= 0) {
+        close(loop->notify_fd);
+    }
+
+    free_mpmc_queue(&loop->completions);
+    free_coroutine_pool(&loop->coroutines);
+
+    free(loop);
+}
@@ -0,0 +1,285 @@
+#include "fd_cache.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+static pthread_mutex_t cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static fd_cache_entry_t* buckets[FD_CACHE_BUCKETS];
+static fd_cache_entry_t* lru_head;
+static fd_cache_entry_t* lru_tail;
+static int entry_count = 0;
+static int max_entries = 0;
+static long long idle_ms = FD_CACHE_IDLE_SEC * 1000LL;
+static uint64_t generation = 0;
+static bool cache_ready = false;
+
+static atomic_llong cache_hits;
+static atomic_llong cache_misses;
+static atomic_llong cache_evictions;
+static atomic_llong cache_expirations;
+static atomic_llong cache_invalidations;
+
+static uint64_t hash_path(const char* path) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+        hash = (hash ^ *p) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// The coarse clock is read from the vDSO, which keeps hits syscall-free
+static long long coarse_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (long long)ts.tv_sec * 1000LL + ts.tv_nsec / 1000000;
+}
+
+void fd_cache_release(fd_cache_entry_t* entry) {
+    if (entry && atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+        close(entry->fd);
+        free(entry->path);
+        free(entry);
+    }
+}
+
+static void lru_unlink(fd_cache_entry_t* entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(fd_cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = lru_head;
+    if (lru_head) {
+        lru_head->lru_prev = entry;
+    } else {
+        lru_tail = entry;
+    }
+    lru_head = entry;
+}
+
+// Caller holds cache_lock
+static void remove_entry(fd_cache_entry_t* entry) {
+    fd_cache_entry_t** link = &buckets[entry->hash % FD_CACHE_BUCKETS];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = entry->hash_next;
+    }
+
+    lru_unlink(entry);
+    entry_count--;
+    entry->cached = false;
+    entry->hash_next = NULL;
+    fd_cache_release(entry);
+}
+
+// Caller holds cache_lock
+static void expire_idle(long long now) {
+    while (lru_tail && now - lru_tail->last_used_ms > idle_ms) {
+        remove_entry(lru_tail);
+        atomic_fetch_add_explicit(&cache_expirations, 1, memory_order_relaxed);
+    }
+}
+
+static fd_cache_entry_t* find_entry(const char* path, uint64_t hash) {
+    for (fd_cache_entry_t* entry = buckets[hash % FD_CACHE_BUCKETS]; entry; entry = entry->hash_next) {
+        if (entry->hash == hash && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+int init_fd_cache(int entries, int idle_sec) {
+    if (entries < 0 || idle_sec < 0) {
+        return -1;
+    }
+
+    max_entries = entries;
+    idle_ms = idle_sec * 1000LL;
+    cache_ready = entries > 0;
+    return 0;
+}
+
+fd_cache_entry_t* fd_cache_lookup(const char* path) {
+    if (!cache_ready) {
+        return NULL;
+    }
+
+    uint64_t hash = hash_path(path);
+    long long now = coarse_ms();
+
+    pthread_mutex_lock(&cache_lock);
+    fd_cache_entry_t* entry = find_entry(path, hash);
+    if (entry && now - entry->last_used_ms > idle_ms) {
+        remove_entry(entry);
+        atomic_fetch_add_explicit(&cache_expirations, 1, memory_order_relaxed);
+        entry = NULL;
+    }
+    if (entry) {
+        atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+        entry->last_used_ms = now;
+        if (lru_head != entry) {
+            lru_unlink(entry);
+            lru_push_front(entry);
+        }
+    }
+    pthread_mutex_unlock(&cache_lock);
+
+    atomic_fetch_add_explicit(entry ? &cache_hits : &cache_misses, 1, memory_order_relaxed);
+    return entry;
+}
+
+static fd_cache_entry_t* open_entry(const char* path, uint64_t hash) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        errno = ENOENT;
+        return NULL;
+    }
+
+    fd_cache_entry_t* entry = calloc(1, sizeof(fd_cache_entry_t));
+    if (!entry || !(entry->path = strdup(path))) {
+        free(entry);
+        close(fd);
+        errno = ENOMEM;
+        return NULL;
+    }
+    entry->hash = hash;
+    entry->fd = fd;
+    entry->size = (size_t)st.st_size;
+    entry->mtime = st.st_mtime;
+    atomic_init(&entry->refs, 1);
+    return entry;
+}
+
+// Blocking: call from a worker, after fd_cache_lookup() missed
+fd_cache_entry_t* fd_cache_open(const char* path) {
+    uint64_t hash = hash_path(path);
+
+    pthread_mutex_lock(&cache_lock);
+    uint64_t opened_generation = generation;
+    pthread_mutex_unlock(&cache_lock);
+
+    fd_cache_entry_t* entry = open_entry(path, hash);
+    if (!entry || !cache_ready) {
+        return entry;
+    }
+
+    long long now = coarse_ms();
+    pthread_mutex_lock(&cache_lock);
+    // An invalidation during the open may mean this is already the old file
+    if (find_entry(path, hash) || generation != opened_generation) {
+        pthread_mutex_unlock(&cache_lock);
+        return entry;
+    }
+
+    expire_idle(now);
+    if (entry_count >= max_entries && lru_tail) {
+        remove_entry(lru_tail);
+        atomic_fetch_add_explicit(&cache_evictions, 1, memory_order_relaxed);
+    }
+
+    fd_cache_entry_t** bucket = &buckets[hash % FD_CACHE_BUCKETS];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    lru_push_front(entry);
+    entry->last_used_ms = now;
+    entry->cached = true;
+    entry_count++;
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&cache_lock);
+    return entry;
+}
+
+void fd_cache_invalidate(const char* path) {
+    if (!cache_ready) {
+        return;
+    }
+
+    uint64_t hash = hash_path(path);
+
+    pthread_mutex_lock(&cache_lock);
+    generation++;
+    fd_cache_entry_t* entry = find_entry(path, hash);
+    if (entry) {
+        remove_entry(entry);
+        atomic_fetch_add_explicit(&cache_invalidations, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void fd_cache_clear(void) {
+    if (!cache_ready) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    generation++;
+    while (lru_head) {
+        remove_entry(lru_head);
+        atomic_fetch_add_explicit(&cache_invalidations, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&cache_lock);
+}
+
+void expire_fd_cache(void) {
+    if (!cache_ready) {
+        return;
+    }
+
+    pthread_mutex_lock(&cache_lock);
+    expire_idle(coarse_ms());
+    pthread_mutex_unlock(&cache_lock);
+}
+
+int format_fd_cache_stats(char* buffer, size_t size) {
+    pthread_mutex_lock(&cache_lock);
+    int open_entries = entry_count;
+    pthread_mutex_unlock(&cache_lock);
+
+    int written = snprintf(buffer, size,
+                           "fd_cache_hits %lld\nfd_cache_misses %lld\n"
+                           "fd_cache_evictions %lld\nfd_cache_expirations %lld\n"
+                           "fd_cache_invalidations %lld\nfd_cache_open %d\n",
+                           atomic_load_explicit(&cache_hits, memory_order_relaxed),
+                           atomic_load_explicit(&cache_misses, memory_order_relaxed),
+                           atomic_load_explicit(&cache_evictions, memory_order_relaxed),
+                           atomic_load_explicit(&cache_expirations, memory_order_relaxed),
+                           atomic_load_explicit(&cache_invalidations, memory_order_relaxed),
+                           open_entries);
+    if (written < 0 || (size_t)written >= size) {
+        return -1;
+    }
+    return written;
+}
+
+void free_fd_cache(void) {
+    if (!cache_ready) {
+        return;
+    }
+
+    fd_cache_clear();
+    cache_ready = false;
+}
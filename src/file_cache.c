@@ -0,0 +1,417 @@
+#include "file_cache.h"
+#include "http_cache.h"
+#include "minify.h"
+#ifdef BLINK_EMBED_WWW
+#include "embedded_files.h"
+#endif
+#include "websocket.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+typedef struct {
+    pthread_mutex_t lock;
+    file_cache_entry_t* buckets[FILE_CACHE_BUCKETS];
+    file_cache_entry_t* lru_head;
+    file_cache_entry_t* lru_tail;
+    size_t bytes;
+    uint64_t generation;
+} file_cache_shard_t;
+
+static file_cache_shard_t shards[FILE_CACHE_SHARDS];
+static size_t shard_budget = 0;
+static bool cache_ready = false;
+
+static atomic_llong cache_hits;
+static atomic_llong cache_misses;
+static atomic_llong cache_evictions;
+static atomic_llong cache_invalidations;
+
+static uint64_t hash_path(const char* path) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const unsigned char* p = (const unsigned char*)path; *p; p++) {
+        hash = (hash ^ *p) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static file_cache_shard_t* shard_for(uint64_t hash) {
+    return &shards[hash >> 60];
+}
+
+static size_t entry_cost(const file_cache_entry_t* entry) {
+    size_t cost = sizeof(file_cache_entry_t) + strlen(entry->path) + 1 + (entry->data ? entry->size + 1 : 0);
+    cost += entry->rendered ? entry->rendered_size : 0;
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        cost += entry->variants[i] ? entry->variant_sizes[i] : 0;
+    }
+    return cost;
+}
+
+static void destroy_entry(file_cache_entry_t* entry) {
+    free(entry->path);
+    free(entry->data);
+    free(entry->rendered);
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        free(entry->variants[i]);
+    }
+    free(entry);
+}
+
+void file_cache_release(file_cache_entry_t* entry) {
+    if (entry && atomic_fetch_sub_explicit(&entry->refs, 1, memory_order_acq_rel) == 1) {
+        destroy_entry(entry);
+    }
+}
+
+static void lru_unlink(file_cache_shard_t* shard, file_cache_entry_t* entry) {
+    if (entry->lru_prev) {
+        entry->lru_prev->lru_next = entry->lru_next;
+    } else {
+        shard->lru_head = entry->lru_next;
+    }
+    if (entry->lru_next) {
+        entry->lru_next->lru_prev = entry->lru_prev;
+    } else {
+        shard->lru_tail = entry->lru_prev;
+    }
+    entry->lru_prev = entry->lru_next = NULL;
+}
+
+static void lru_push_front(file_cache_shard_t* shard, file_cache_entry_t* entry) {
+    entry->lru_prev = NULL;
+    entry->lru_next = shard->lru_head;
+    if (shard->lru_head) {
+        shard->lru_head->lru_prev = entry;
+    } else {
+        shard->lru_tail = entry;
+    }
+    shard->lru_head = entry;
+}
+
+// Caller holds the shard lock
+static void remove_entry(file_cache_shard_t* shard, file_cache_entry_t* entry) {
+    file_cache_entry_t** link = &shard->buckets[entry->hash % FILE_CACHE_BUCKETS];
+    while (*link && *link != entry) {
+        link = &(*link)->hash_next;
+    }
+    if (*link) {
+        *link = entry->hash_next;
+    }
+
+    lru_unlink(shard, entry);
+    shard->bytes -= entry_cost(entry);
+    entry->cached = false;
+    entry->hash_next = NULL;
+    file_cache_release(entry);
+}
+
+// Caller holds the shard lock
+static void evict_over_budget(file_cache_shard_t* shard) {
+    while (shard->bytes > shard_budget && shard->lru_tail) {
+        remove_entry(shard, shard->lru_tail);
+        atomic_fetch_add_explicit(&cache_evictions, 1, memory_order_relaxed);
+    }
+}
+
+static file_cache_entry_t* find_entry(file_cache_shard_t* shard, const char* path, uint64_t hash) {
+    for (file_cache_entry_t* entry = shard->buckets[hash % FILE_CACHE_BUCKETS]; entry; entry = entry->hash_next) {
+        if (entry->hash == hash && strcmp(entry->path, path) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+int init_file_cache(size_t budget_bytes) {
+    for (int i = 0; i < FILE_CACHE_SHARDS; i++) {
+        if (pthread_mutex_init(&shards[i].lock, NULL) != 0) {
+            while (--i >= 0) {
+                pthread_mutex_destroy(&shards[i].lock);
+            }
+            return -1;
+        }
+    }
+
+    shard_budget = budget_bytes / FILE_CACHE_SHARDS;
+    cache_ready = true;
+    return 0;
+}
+
+file_cache_entry_t* file_cache_lookup(const char* path) {
+    if (!cache_ready) {
+        return NULL;
+    }
+
+    uint64_t hash = hash_path(path);
+    file_cache_shard_t* shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    file_cache_entry_t* entry = find_entry(shard, path, hash);
+    if (entry) {
+        atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+        if (shard->lru_head != entry) {
+            lru_unlink(shard, entry);
+            lru_push_front(shard, entry);
+        }
+    }
+    pthread_mutex_unlock(&shard->lock);
+
+    atomic_fetch_add_explicit(entry ? &cache_hits : &cache_misses, 1, memory_order_relaxed);
+    return entry;
+}
+
+// Terminates the bytes and applies the load-time passes
+static void finish_entry(file_cache_entry_t* entry) {
+    entry->data[entry->size] = '\0';
+    if (minify_applies(entry->path)) {
+        entry->size = minify_html(entry->data, entry->size);
+    }
+    if (http_cache_enabled()) {
+        entry->data_hash = xxh64(entry->data, entry->size, 0);
+    }
+}
+
+#ifdef BLINK_EMBED_WWW
+// The web root is compiled in, so anything under it that was not embedded does not exist
+static file_cache_entry_t* read_embedded_entry(file_cache_entry_t* entry) {
+    const embedded_file_t* file = find_embedded_file(entry->path);
+    if (!file) {
+        entry->missing = true;
+        return entry;
+    }
+
+    entry->size = file->size;
+    entry->mtime = file->mtime;
+    entry->data = malloc(entry->size + 1);
+    if (!entry->data) {
+        perror("Error allocating memory");
+        destroy_entry(entry);
+        return NULL;
+    }
+    memcpy(entry->data, file->data, entry->size);
+    finish_entry(entry);
+    return entry;
+}
+#endif
+
+static file_cache_entry_t* read_entry(const char* path, uint64_t hash) {
+    file_cache_entry_t* entry = calloc(1, sizeof(file_cache_entry_t));
+    if (!entry || !(entry->path = strdup(path))) {
+        free(entry);
+        return NULL;
+    }
+    entry->hash = hash;
+    atomic_init(&entry->refs, 1);
+
+#ifdef BLINK_EMBED_WWW
+    if (embedded_root_path(path)) {
+        return read_embedded_entry(entry);
+    }
+#endif
+
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        if (errno == ENOENT || errno == ENOTDIR) {
+            entry->missing = true;
+            return entry;
+        }
+        perror("Error opening file");
+        destroy_entry(entry);
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        entry->missing = true;
+        return entry;
+    }
+
+    entry->size = (size_t)st.st_size;
+    entry->mtime = st.st_mtime;
+    entry->data = malloc(entry->size + 1);
+    if (!entry->data) {
+        perror("Error allocating memory");
+        close(fd);
+        destroy_entry(entry);
+        return NULL;
+    }
+
+    size_t done = 0;
+    while (done < entry->size) {
+        ssize_t n = read(fd, entry->data + done, entry->size - done);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        done += (size_t)n;
+    }
+    close(fd);
+
+    if (done != entry->size) {
+        perror("Error reading file");
+        destroy_entry(entry);
+        return NULL;
+    }
+    finish_entry(entry);
+    return entry;
+}
+
+// Whether a file of this size would be kept once read, so callers can skip the read
+bool file_cache_fits(const char* path, size_t size) {
+    return cache_ready && sizeof(file_cache_entry_t) + strlen(path) + 1 + size + 1 <= shard_budget;
+}
+
+file_cache_entry_t* file_cache_load(const char* path) {
+    file_cache_entry_t* entry = file_cache_lookup(path);
+    if (entry) {
+        return entry;
+    }
+
+    uint64_t hash = hash_path(path);
+    file_cache_shard_t* shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    uint64_t generation = shard->generation;
+    pthread_mutex_unlock(&shard->lock);
+
+    entry = read_entry(path, hash);
+    if (!entry || !cache_ready || entry_cost(entry) > shard_budget) {
+        return entry;
+    }
+
+    pthread_mutex_lock(&shard->lock);
+    file_cache_entry_t* existing = find_entry(shard, path, hash);
+    // An invalidation during the read may mean these bytes are already stale
+    if (existing || shard->generation != generation) {
+        pthread_mutex_unlock(&shard->lock);
+        return entry;
+    }
+
+    shard->bytes += entry_cost(entry);
+    evict_over_budget(shard);
+
+    file_cache_entry_t** bucket = &shard->buckets[hash % FILE_CACHE_BUCKETS];
+    entry->hash_next = *bucket;
+    *bucket = entry;
+    lru_push_front(shard, entry);
+    entry->cached = true;
+    atomic_fetch_add_explicit(&entry->refs, 1, memory_order_relaxed);
+    pthread_mutex_unlock(&shard->lock);
+    return entry;
+}
+
+bool file_cache_attach_rendered(file_cache_entry_t* entry, char* body, size_t size) {
+    file_cache_shard_t* shard = shard_for(entry->hash);
+    uint64_t rendered_hash = http_cache_enabled() ? xxh64(body, size, 0) : 0;
+    bool attached = false;
+
+    pthread_mutex_lock(&shard->lock);
+    if (entry->cached && !entry->rendered &&
+        atomic_load_explicit(&entry->variant_state, memory_order_relaxed) == VARIANTS_NONE) {
+        entry->rendered = body;
+        entry->rendered_size = size;
+        entry->rendered_hash = rendered_hash;
+        shard->bytes += size;
+        attached = true;
+        evict_over_budget(shard);
+    }
+    pthread_mutex_unlock(&shard->lock);
+    return attached;
+}
+
+void file_cache_attach_variants(file_cache_entry_t* entry, char** variants, const size_t* sizes) {
+    file_cache_shard_t* shard = shard_for(entry->hash);
+
+    pthread_mutex_lock(&shard->lock);
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        entry->variants[i] = variants[i];
+        entry->variant_sizes[i] = sizes[i];
+        if (entry->cached && variants[i]) {
+            shard->bytes += sizes[i];
+        }
+    }
+    atomic_store_explicit(&entry->variant_state, VARIANTS_READY, memory_order_release);
+    if (entry->cached) {
+        evict_over_budget(shard);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void file_cache_invalidate(const char* path) {
+    if (!cache_ready) {
+        return;
+    }
+
+    uint64_t hash = hash_path(path);
+    file_cache_shard_t* shard = shard_for(hash);
+
+    pthread_mutex_lock(&shard->lock);
+    shard->generation++;
+    file_cache_entry_t* entry = find_entry(shard, path, hash);
+    if (entry) {
+        remove_entry(shard, entry);
+        atomic_fetch_add_explicit(&cache_invalidations, 1, memory_order_relaxed);
+    }
+    pthread_mutex_unlock(&shard->lock);
+}
+
+void file_cache_clear(void) {
+    if (!cache_ready) {
+        return;
+    }
+
+    for (int i = 0; i < FILE_CACHE_SHARDS; i++) {
+        file_cache_shard_t* shard = &shards[i];
+        pthread_mutex_lock(&shard->lock);
+        shard->generation++;
+        while (shard->lru_head) {
+            remove_entry(shard, shard->lru_head);
+            atomic_fetch_add_explicit(&cache_invalidations, 1, memory_order_relaxed);
+        }
+        pthread_mutex_unlock(&shard->lock);
+    }
+}
+
+int format_file_cache_stats(char* buffer, size_t size) {
+    size_t bytes = 0;
+    for (int i = 0; cache_ready && i < FILE_CACHE_SHARDS; i++) {
+        pthread_mutex_lock(&shards[i].lock);
+        bytes += shards[i].bytes;
+        pthread_mutex_unlock(&shards[i].lock);
+    }
+
+    int written = snprintf(buffer, size,
+                           "file_cache_hits %lld\nfile_cache_misses %lld\n"
+                           "file_cache_evictions %lld\nfile_cache_invalidations %lld\n"
+                           "file_cache_bytes %zu\n",
+                           atomic_load_explicit(&cache_hits, memory_order_relaxed),
+                           atomic_load_explicit(&cache_misses, memory_order_relaxed),
+                           atomic_load_explicit(&cache_evictions, memory_order_relaxed),
+                           atomic_load_explicit(&cache_invalidations, memory_order_relaxed),
+                           bytes);
+    if (written < 0 || (size_t)written >= size) {
+        return -1;
+    }
+    return written;
+}
+
+void free_file_cache(void) {
+    if (!cache_ready) {
+        return;
+    }
+
+    file_cache_clear();
+    cache_ready = false;
+    for (int i = 0; i < FILE_CACHE_SHARDS; i++) {
+        pthread_mutex_destroy(&shards[i].lock);
+    }
+}
@@ -1,6 +1,9 @@
 #include "file_watcher.h"
 #include "websocket.h" 
 #include "request_handler.h"
+#include "file_cache.h"
+#include "fd_cache.h"
+#include "route_table.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -18,7 +21,16 @@ typedef struct {
     int capacity;
 } html_files_t;
 
+typedef struct {
+    int wd;
+    char* path;
+} watched_dir_t;
+
 static html_files_t* html_files = NULL;
+static int custom_dir_wd = -1;
+static char custom_dir[512];
+static watched_dir_t watched_dirs[WATCH_MAX_DIRS];
+static int watched_dir_count = 0;
 
 static html_files_t* init_html_files() {
     html_files_t* files = malloc(sizeof(html_files_t));
@@ -123,6 +135,70 @@ static void add_custom_html_file_if_exists(html_files_t* files) {
     }
 }
 
+// inotify is not recursive, so every directory under the web root gets its own watch
+static void watch_tree(int fd, const char* directory, int depth) {
+    if (watched_dir_count >= WATCH_MAX_DIRS) {
+        return;
+    }
+
+    int wd = inotify_add_watch(fd, directory, WATCH_MASK);
+    if (wd < 0) {
+        return;
+    }
+    for (int i = 0; i < watched_dir_count; i++) {
+        if (watched_dirs[i].wd == wd) {
+            return;
+        }
+    }
+    watched_dirs[watched_dir_count].wd = wd;
+    watched_dirs[watched_dir_count].path = strdup(directory);
+    watched_dir_count++;
+
+    DIR* dir = depth < ROUTE_MAX_DEPTH ? opendir(directory) : NULL;
+    if (!dir) {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        char path[512];
+        struct stat st;
+        if (entry->d_name[0] == '.' ||
+            snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name) >= (int)sizeof(path)) {
+            continue;
+        }
+        if (stat(path, &st) == 0 && S_ISDIR(st.st_mode)) {
+            watch_tree(fd, path, depth + 1);
+        }
+    }
+    closedir(dir);
+}
+
+static const char* watched_dir_path(int wd) {
+    for (int i = 0; i < watched_dir_count; i++) {
+        if (watched_dirs[i].wd == wd) {
+            return watched_dirs[i].path;
+        }
+    }
+    return NULL;
+}
+
+static void forget_watch(int index) {
+    free(watched_dirs[index].path);
+    watched_dirs[index] = watched_dirs[--watched_dir_count];
+}
+
+// A directory moved away keeps its watch, so drop it and everything below
+static void unwatch_tree(int fd, const char* directory) {
+    size_t len = strlen(directory);
+    for (int i = watched_dir_count - 1; i >= 0; i--) {
+        const char* path = watched_dirs[i].path;
+        if (path && strncmp(path, directory, len) == 0 && (path[len] == '\0' || path[len] == '/')) {
+            inotify_rm_watch(fd, watched_dirs[i].wd);
+            forget_watch(i);
+        }
+    }
+}
+
 static void free_html_files(html_files_t* files) {
     if (!files) return;
     
@@ -135,8 +211,10 @@ static void free_html_files(html_files_t* files) {
     free(files);
 }
 
-int init_file_watcher(const char* directory, bool* file_changed, pthread_mutex_t* mutex) {
-    if (!directory || !file_changed || !mutex) {
+int init_file_watcher(const char* directory) {
+    extern char* custom_html_file;
+
+    if (!directory) {
         return -1;
     }
 
@@ -152,8 +230,6 @@ int init_file_watcher(const char* directory, bool* file_changed, pthread_mutex_t
                 BOLD, COLOR_RED, COLOR_RESET, directory, COLOR_RESET);
         return -1;
     }
-
-    *file_changed = false;
     
     html_files = init_html_files();
     if (!html_files) {
@@ -165,239 +241,148 @@ int init_file_watcher(const char* directory, bool* file_changed, pthread_mutex_t
     scan_directory(directory, html_files);
     
     add_custom_html_file_if_exists(html_files);
-    
-    printf("%s%s[FILE WATCHER] %sInitialized for directory: %s%s%s (tracking %s%d%s HTML files)\n", 
-           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, directory, COLOR_RESET, 
-           COLOR_YELLOW, html_files->count, COLOR_RESET);
-    
-    return 0;
-}
-
-pthread_t start_file_watcher(const char* directory, bool* file_changed, pthread_mutex_t* mutex) {
-    pthread_t thread_id;
-    watcher_args_t* args = malloc(sizeof(watcher_args_t));
-    
-    if (!args) {
-        fprintf(stderr, "%s%s[ERROR] %sFailed to allocate memory for watcher args: %s%s\n", 
-                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-        return 0;
-    }
-    
-    args->directory = strdup(directory);
-    args->file_changed = file_changed;
-    args->mutex = mutex;
-    
-    if (pthread_create(&thread_id, NULL, watch_files, args) != 0) {
-        fprintf(stderr, "%s%s[ERROR] %sFailed to create file watcher thread: %s%s\n", 
-                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-        free(args->directory);
-        free(args);
-        return 0;
-    }
-    
-    return thread_id;
-}
-
-bool file_has_changed(const char* filename, time_t* last_modified) {
-    struct stat attr;
-    if (stat(filename, &attr) == 0) {
-        if (*last_modified == 0 || attr.st_mtime > *last_modified) {
-            time_t old_time = *last_modified;
-            *last_modified = attr.st_mtime;
-            return (old_time != 0 && old_time != attr.st_mtime);
-        }
-    }
-    return false;
-}
-
-static bool check_all_files_for_changes(html_files_t* files) {
-    if (!files || files->count == 0) return false;
-    
-    static char* last_changed_file = NULL;
-    static time_t last_change_time = 0;
-    time_t current_time = time(NULL);
-    const int SAME_FILE_DEBOUNCE_SECS = 5;
-    
-    bool any_changed = false;
-    for (int i = 0; i < files->count; i++) {
-        if (file_has_changed(files->filenames[i], &files->last_modified[i])) {
-            bool is_repeat = (last_changed_file && strcmp(files->filenames[i], last_changed_file) == 0);
-            bool within_debounce = (difftime(current_time, last_change_time) < SAME_FILE_DEBOUNCE_SECS);
-            
-            if (!is_repeat || !within_debounce) {
-                printf("%s%s[FILE WATCHER] %sDetected change in file: %s%s%s\n", 
-                       BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, 
-                       files->filenames[i], COLOR_RESET);
-                
-                if (last_changed_file) {
-                    free(last_changed_file);
-                }
-                last_changed_file = strdup(files->filenames[i]);
-                last_change_time = current_time;
-            }
-            
-            any_changed = true;
-        }
-    }
-    
-    return any_changed;
-}
 
-static void rescan_directory_if_needed(const char* directory, html_files_t* files) {
-    static time_t last_scan_time = 0;
-    time_t current_time = time(NULL);
-    
-    if (difftime(current_time, last_scan_time) > 30) {
-        printf("%s%s[FILE WATCHER] %sRescanning directory for new HTML files...%s\n", 
-               BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
-        
-        scan_directory(directory, files);
-        add_custom_html_file_if_exists(files);
-        
-        last_scan_time = current_time;
-    }
-}
-
-void* watch_files(void* args) {
-    watcher_args_t* watcher_args = (watcher_args_t*)args;
-    int fd, wd, custom_file_wd = -1;
-    char buffer[BUF_LEN];
-    extern char* custom_html_file; 
-    
-    time_t last_notification_time = 0;
-    const int DEBOUNCE_TIME_MS = 1000;
-    fd = inotify_init();
+    int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     if (fd < 0) {
         fprintf(stderr, "%s%s[ERROR] %sinotify_init failed: %s%s\n", 
                 BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-        free(watcher_args->directory);
-        free(watcher_args);
-        return NULL;
+        free_html_files(html_files);
+        html_files = NULL;
+        return -1;
     }
     
-    wd = inotify_add_watch(fd, watcher_args->directory, 
-                          IN_MODIFY | IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB);
-    if (wd < 0) {
+    watch_tree(fd, directory, 0);
+    if (watched_dir_count == 0) {
         fprintf(stderr, "%s%s[ERROR] %sinotify_add_watch failed: %s%s\n", 
                 BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
         close(fd);
-        free(watcher_args->directory);
-        free(watcher_args);
-        return NULL;
+        free_html_files(html_files);
+        html_files = NULL;
+        return -1;
     }
     
     if (custom_html_file && *custom_html_file) {
         char* last_slash = strrchr(custom_html_file, '/');
-        if (last_slash) {
-            char custom_dir[512] = {0};
-            strncpy(custom_dir, custom_html_file, last_slash - custom_html_file);
-            custom_dir[last_slash - custom_html_file] = '\0';
+        if (!last_slash) {
+            // Bare file name in the working directory, keyed without a prefix
+            custom_dir_wd = inotify_add_watch(fd, ".", WATCH_MASK);
+            custom_dir[0] = '\0';
+        } else {
+            size_t dir_len = last_slash - custom_html_file;
+            if (dir_len >= sizeof(custom_dir)) {
+                dir_len = sizeof(custom_dir) - 1;
+            }
+            strncpy(custom_dir, custom_html_file, dir_len);
+            custom_dir[dir_len] = '\0';
             
-            if (strcmp(custom_dir, watcher_args->directory) != 0) {
-                custom_file_wd = inotify_add_watch(fd, custom_dir, 
-                                  IN_MODIFY | IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_ATTRIB);
-                
-                if (custom_file_wd >= 0) {
-                    printf("%s%s[FILE WATCHER] %sAdded watch for custom HTML file directory: %s%s%s\n", 
-                           BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, custom_dir, COLOR_RESET);
-                }
+            if (strcmp(custom_dir, directory) != 0 &&
+                (custom_dir_wd = inotify_add_watch(fd, custom_dir, WATCH_MASK)) >= 0) {
+                printf("%s%s[FILE WATCHER] %sAdded watch for custom HTML file directory: %s%s%s\n", 
+                       BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, custom_dir, COLOR_RESET);
             }
         }
     }
     
-    printf("%s%s[FILE WATCHER] %sActive - watching directory: %s%s%s\n", 
-           BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, watcher_args->directory, COLOR_RESET);
+    printf("%s%s[FILE WATCHER] %sInitialized for directory: %s%s%s (tracking %s%d%s HTML files)\n", 
+           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, directory, COLOR_RESET, 
+           COLOR_YELLOW, html_files->count, COLOR_RESET);
     
-    while (1) {
-        bool change_detected = false;
-        if (check_all_files_for_changes(html_files)) {
-            change_detected = true;
+    return fd;
+}
+
+bool process_file_events(int watch_fd, const char* directory) {
+    char buffer[BUF_LEN] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool change_detected = false;
+    
+    for (;;) {
+        ssize_t length = read(watch_fd, buffer, BUF_LEN);
+        if (length < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                fprintf(stderr, "%s%s[FILE WATCHER] %sRead error: %s%s\n", 
+                        BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+            }
+            break;
+        }
+        if (length == 0) {
+            break;
         }
         
-        fd_set read_fds;
-        FD_ZERO(&read_fds);
-        FD_SET(fd, &read_fds);       
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 100000;
-        
-        int ret = select(fd + 1, &read_fds, NULL, NULL, &tv);
-        
-        if (ret > 0 && FD_ISSET(fd, &read_fds)) {
-            int length = read(fd, buffer, BUF_LEN);
-            if (length > 0) {
-                int i = 0;
-                while (i < length) {
-                    struct inotify_event* event = (struct inotify_event*)&buffer[i];
-                    
-                    if (event->len > 0) {
-                        char* dot = strrchr(event->name, '.');
-                        if (dot && (strcmp(dot, ".html") == 0)) {
-                            printf("%s%s[FILE WATCHER] %sEvent detected: %s%s%s (mask: 0x%08x)\n", 
-                                   BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, event->name, COLOR_RESET, event->mask);
-                            change_detected = true;
-                            char full_path[512];
-                            snprintf(full_path, sizeof(full_path), "%s/%s", 
-                                     watcher_args->directory, event->name);
-                            add_html_file(html_files, full_path);
-                        }
+        ssize_t i = 0;
+        while (i < length) {
+            struct inotify_event* event = (struct inotify_event*)&buffer[i];
+            
+            if (event->mask & IN_Q_OVERFLOW) {
+                file_cache_clear();
+                fd_cache_clear();
+                rebuild_route_table();
+                change_detected = true;
+            }
+            if (event->mask & IN_IGNORED) {
+                for (int j = 0; j < watched_dir_count; j++) {
+                    if (watched_dirs[j].wd == event->wd) {
+                        forget_watch(j);
+                        break;
                     }
-                    
-                    i += EVENT_SIZE + event->len;
                 }
             }
-        } else if (ret < 0 && errno != EINTR) {
-            fprintf(stderr, "%s%s[FILE WATCHER] %sSelect error: %s%s\n", 
-                    BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-        }
-        
-        rescan_directory_if_needed(watcher_args->directory, html_files);
-        if (change_detected) {
-            time_t current_time = time(NULL);
-            double ms_since_last = difftime(current_time, last_notification_time) * 1000;
-            if (ms_since_last >= DEBOUNCE_TIME_MS) {
-                bool already_signaled = false;
-                pthread_mutex_lock(watcher_args->mutex);
-                already_signaled = *(watcher_args->file_changed);
-                pthread_mutex_unlock(watcher_args->mutex);
-                
-                if (!already_signaled) {
-                    usleep(100000);                    
-                    pthread_mutex_lock(watcher_args->mutex);
-                    *(watcher_args->file_changed) = true;
-                    pthread_mutex_unlock(watcher_args->mutex);                   
-                    printf("%s%s[FILE WATCHER] %sSignaled main thread about file changes%s\n", 
-                           BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_RESET);
-                    last_notification_time = current_time;
-                } else {
-                    static time_t last_skip_message = 0;
-                    if (difftime(current_time, last_skip_message) > 5) {
-                        printf("%s%s[FILE WATCHER] %sSkipping notification - one already pending%s\n", 
-                               BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
-                        last_skip_message = current_time;
+
+            if (event->len > 0) {
+                char changed_path[512];
+                const char* event_dir = watched_dir_path(event->wd);
+                snprintf(changed_path, sizeof(changed_path), "%s/%s", event_dir ? event_dir : directory, event->name);
+                file_cache_invalidate(changed_path);
+                fd_cache_invalidate(changed_path);
+
+                if (event->mask & IN_ISDIR) {
+                    if (event->mask & (IN_CREATE | IN_MOVED_TO)) {
+                        watch_tree(watch_fd, changed_path, 1);
+                        route_directory_added(changed_path);
+                    } else if (event->mask & (IN_DELETE | IN_MOVED_FROM)) {
+                        unwatch_tree(watch_fd, changed_path);
+                        route_directory_removed(changed_path);
+                        file_cache_clear();
+                        fd_cache_clear();
                     }
+                    change_detected = true;
+                } else if (event_dir && (event->mask & (IN_DELETE | IN_MOVED_FROM))) {
+                    route_file_removed(changed_path);
+                } else if (event_dir) {
+                    route_file_added(changed_path);
                 }
-            } else {
-                static time_t last_debounce_message = 0;
-                if (difftime(current_time, last_debounce_message) > 5) {
-                    printf("%s%s[FILE WATCHER] %sDebouncing - %d ms since last notification%s\n", 
-                           BOLD, COLOR_BLUE, COLOR_CYAN, (int)ms_since_last, COLOR_RESET);
-                    last_debounce_message = current_time;
+                // Both spellings, in case the two watches share an inode
+                if (event->wd == custom_dir_wd) {
+                    snprintf(changed_path, sizeof(changed_path), "%s%s%s", custom_dir,
+                             custom_dir[0] ? "/" : "", event->name);
+                    file_cache_invalidate(changed_path);
+                }
+
+                char* dot = strrchr(event->name, '.');
+                if (dot && (strcmp(dot, ".html") == 0)) {
+                    printf("%s%s[FILE WATCHER] %sEvent detected: %s%s%s (mask: 0x%08x)\n", 
+                           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, event->name, COLOR_RESET, event->mask);
+                    change_detected = true;
+                    add_html_file(html_files, changed_path);
                 }
             }
+            
+            i += EVENT_SIZE + event->len;
         }
-        usleep(100000); 
     }
     
-    if (custom_file_wd >= 0) {
-        inotify_rm_watch(fd, custom_file_wd);
+    return change_detected;
+}
+
+void close_file_watcher(int watch_fd) {
+    if (watch_fd >= 0) {
+        close(watch_fd);
+    }
+    custom_dir_wd = -1;
+    while (watched_dir_count > 0) {
+        forget_watch(watched_dir_count - 1);
     }
-    inotify_rm_watch(fd, wd);
-    close(fd);
-    
-    free(watcher_args->directory);
-    free(watcher_args);
     free_html_files(html_files);
-    
-    return NULL;
-} 
\ No newline at end of file
+    html_files = NULL;
+}
@@ -1,5 +1,6 @@
 #include "handle_client.h"
 #include "websocket.h"
+#include "static_files.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -29,22 +30,6 @@ static int set_socket_timeout(int sockfd, int seconds) {
     return 0;
 }
 
-const char* get_content_type(const char* path) {
-    const char* ext = strrchr(path, '.');
-    if (ext) {
-        if (strcmp(ext, ".html") == 0) return "text/html";
-        if (strcmp(ext, ".css") == 0) return "text/css";
-        if (strcmp(ext, ".js") == 0) return "application/javascript";
-        if (strcmp(ext, ".json") == 0) return "application/json";
-        if (strcmp(ext, ".png") == 0) return "image/png";
-        if (strcmp(ext, ".jpg") == 0 || strcmp(ext, ".jpeg") == 0) return "image/jpeg";
-        if (strcmp(ext, ".gif") == 0) return "image/gif";
-        if (strcmp(ext, ".svg") == 0) return "image/svg+xml";
-        if (strcmp(ext, ".ico") == 0) return "image/x-icon";
-    }
-    return "text/plain";
-}
-
 static int read_request_line(int client_socket, char* buffer, size_t buffer_size) {
     if (set_socket_timeout(client_socket, READ_TIMEOUT_SECS) < 0) {
         return -1;
@@ -1,56 +1,56 @@
 #include "html_serve.h"
+#include "coroutine.h"
+#include "file_cache.h"
 
-char* serve_html(const char* filename) {
-    FILE* file = fopen(filename, "r");
-    if (!file) {
-        perror("Error opening file");
-        return NULL;
-    }
-    if (fseek(file, 0, SEEK_END) != 0) {
-        perror("Error seeking to end of file");
-        fclose(file);                         
-        return NULL;
-    }
+typedef struct {
+    const char* filename;
+    file_cache_entry_t* entry;
+} read_job_t;
 
-    long length = ftell(file);
-    if (length == -1) {
-        perror("Error getting file size"); 
-        fclose(file);                      
-        return NULL;
-    }
+static void run_read_job(void* arg) {
+    read_job_t* job = (read_job_t*)arg;
+    job->entry = file_cache_load(job->filename);
+}
 
-    if (fseek(file, 0, SEEK_SET) != 0) {
-        perror("Error seeking to beginning of file"); 
-        fclose(file);                                
-        return NULL;
+// Hits are served on the calling thread, only a miss goes to the disk
+file_cache_entry_t* load_cached_file(const char* filename) {
+    file_cache_entry_t* entry = file_cache_lookup(filename);
+    if (entry) {
+        return entry;
     }
 
-    char* buffer = malloc(length + 1);
-    if (!buffer) {
-        perror("Error allocating memory"); 
-        fclose(file);                    
-        return NULL;
-    }
+    read_job_t job = { filename, NULL };
+    run_blocking(run_read_job, &job);
+    return job.entry;
+}
 
-    if (fread(buffer, 1, length, file) != length) {
-        perror("Error reading file");                  
-        free(buffer);                                 
-        fclose(file);                                 
+bool html_file_exists(const char* filename) {
+    file_cache_entry_t* entry = load_cached_file(filename);
+    bool exists = entry && !entry->missing;
+    file_cache_release(entry);
+    return exists;
+}
+
+char* serve_html(const char* filename) {
+    file_cache_entry_t* entry = load_cached_file(filename);
+    if (!entry || entry->missing) {
+        fprintf(stderr, "Error opening file: %s\n", filename);
+        file_cache_release(entry);
         return NULL;
     }
 
-    buffer[length] = '\0'; 
-    fclose(file);         
-    return buffer;         
+    char* buffer = malloc(entry->size + 1);
+    if (buffer) {
+        memcpy(buffer, entry->data, entry->size + 1);
+    } else {
+        perror("Error allocating memory");
+    }
+    file_cache_release(entry);
+    return buffer;
 }
 
-char* inject_hot_reload_js(char* html_content) {
-    if (!html_content) {
-        fprintf(stderr, "Error: Null HTML content passed to inject_hot_reload_js\n");
-        return NULL;
-    }
-    
-    const char* hot_reload_js = 
+const char* get_hot_reload_js(size_t* length) {
+    static const char hot_reload_js[] = 
         "<script>\n"
         "// Hot Reload Script\n"
         "(function() {\n"
@@ -106,27 +106,6 @@ char* inject_hot_reload_js(char* html_content) {
         "})();\n"
         "</script>\n";
     
-    char* body_close_tag = strstr(html_content, "</body>");
-    if (!body_close_tag) {
-        printf("No </body> tag found in HTML content, not injecting hot reload script\n");
-        return html_content;
-    }
-    
-    size_t original_len = strlen(html_content);
-    size_t script_len = strlen(hot_reload_js);
-    size_t offset = body_close_tag - html_content;
-    
-    char* new_html = malloc(original_len + script_len + 1);
-    if (!new_html) {
-        perror("Memory allocation failed for hot reload script injection");
-        return html_content;
-    }
-    
-    strncpy(new_html, html_content, offset);
-    new_html[offset] = '\0';
-    strcat(new_html, hot_reload_js);
-    strcat(new_html, body_close_tag);
-    
-    free(html_content);
-    return new_html;
+    *length = sizeof(hot_reload_js) - 1;
+    return hot_reload_js;
 }
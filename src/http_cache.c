@@ -0,0 +1,161 @@
+#define _GNU_SOURCE
+#include "http_cache.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#define XXH_PRIME64_1 0x9E3779B185EBCA87ULL
+#define XXH_PRIME64_2 0xC2B2AE3D27D4EB4FULL
+#define XXH_PRIME64_3 0x165667B19E3779F9ULL
+#define XXH_PRIME64_4 0x85EBCA77C2B2AE63ULL
+#define XXH_PRIME64_5 0x27D4EB2F165667C5ULL
+
+static bool cache_enabled = false;
+
+void configure_http_cache(bool enabled) {
+    cache_enabled = enabled;
+}
+
+bool http_cache_enabled(void) {
+    return cache_enabled;
+}
+
+static uint64_t rotl64(uint64_t value, int bits) {
+    return (value << bits) | (value >> (64 - bits));
+}
+
+static uint64_t read64(const unsigned char* p) {
+    uint64_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint32_t read32(const unsigned char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+static uint64_t xxh64_round(uint64_t acc, uint64_t input) {
+    acc += input * XXH_PRIME64_2;
+    return rotl64(acc, 31) * XXH_PRIME64_1;
+}
+
+static uint64_t xxh64_merge(uint64_t acc, uint64_t value) {
+    acc ^= xxh64_round(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+uint64_t xxh64(const void* data, size_t length, uint64_t seed) {
+    const unsigned char* p = (const unsigned char*)data;
+    const unsigned char* end = p + length;
+    uint64_t hash;
+
+    if (length >= 32) {
+        uint64_t v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        uint64_t v2 = seed + XXH_PRIME64_2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - XXH_PRIME64_1;
+        do {
+            v1 = xxh64_round(v1, read64(p));
+            v2 = xxh64_round(v2, read64(p + 8));
+            v3 = xxh64_round(v3, read64(p + 16));
+            v4 = xxh64_round(v4, read64(p + 24));
+            p += 32;
+        } while (end - p >= 32);
+
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxh64_merge(hash, v1);
+        hash = xxh64_merge(hash, v2);
+        hash = xxh64_merge(hash, v3);
+        hash = xxh64_merge(hash, v4);
+    } else {
+        hash = seed + XXH_PRIME64_5;
+    }
+
+    hash += (uint64_t)length;
+    for (; end - p >= 8; p += 8) {
+        hash ^= xxh64_round(0, read64(p));
+        hash = rotl64(hash, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+    }
+    if (end - p >= 4) {
+        hash ^= (uint64_t)read32(p) * XXH_PRIME64_1;
+        hash = rotl64(hash, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    for (; p < end; p++) {
+        hash ^= *p * XXH_PRIME64_5;
+        hash = rotl64(hash, 11) * XXH_PRIME64_1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= XXH_PRIME64_2;
+    hash ^= hash >> 29;
+    hash *= XXH_PRIME64_3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+void format_etag(char* buffer, size_t size, uint64_t hash, const char* suffix) {
+    snprintf(buffer, size, "\"%016llx%s%s\"", (unsigned long long)hash, suffix ? "-" : "", suffix ? suffix : "");
+}
+
+void format_file_etag(char* buffer, size_t size, size_t length, time_t mtime) {
+    snprintf(buffer, size, "\"%zx-%llx\"", length, (unsigned long long)mtime);
+}
+
+void format_http_date(char* buffer, size_t size, time_t when) {
+    struct tm tm;
+    gmtime_r(&when, &tm);
+    strftime(buffer, size, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+}
+
+// If-None-Match uses the weak comparison, so a W/ prefix is ignored
+static bool etag_listed(http_slice_t value, const char* etag) {
+    size_t etag_len = strlen(etag);
+    const char* p = value.data;
+    const char* end = p + value.len;
+
+    while (p < end) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == ',')) {
+            p++;
+        }
+        if (p < end && *p == '*') {
+            return true;
+        }
+        if (end - p >= 2 && p[0] == 'W' && p[1] == '/') {
+            p += 2;
+        }
+
+        const char* tag = p;
+        if (p < end && *p == '"') {
+            const char* close = memchr(p + 1, '"', end - p - 1);
+            p = close ? close + 1 : end;
+        } else {
+            while (p < end && *p != ',') {
+                p++;
+            }
+        }
+        if ((size_t)(p - tag) == etag_len && memcmp(tag, etag, etag_len) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool request_not_modified(const http_request_t* request, const char* etag, time_t mtime) {
+    const http_slice_t* if_none_match = find_http_header(request, "If-None-Match");
+    if (if_none_match) {
+        return etag && etag_listed(*if_none_match, etag);
+    }
+
+    const http_slice_t* if_modified_since = find_http_header(request, "If-Modified-Since");
+    char date[HTTP_DATE_SIZE];
+    struct tm tm = {0};
+    if (!if_modified_since || mtime <= 0 || http_slice_copy(*if_modified_since, date, sizeof(date)) < 0) {
+        return false;
+    }
+
+    const char* parsed = strptime(date, "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    return parsed && *parsed == '\0' && mtime <= timegm(&tm);
+}
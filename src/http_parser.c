@@ -0,0 +1,315 @@
+#include "http_parser.h"
+#include <string.h>
+#include <strings.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static const char* scan_byte(const char* p, const char* end, char target) {
+#ifdef __SSE2__
+    __m128i needle = _mm_set1_epi8(target);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle));
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end) {
+        if (*p == target) {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+static const char* scan_header_delimiter(const char* p, const char* end) {
+#ifdef __SSE2__
+    __m128i colon = _mm_set1_epi8(':');
+    __m128i cr = _mm_set1_epi8('\r');
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128((const __m128i*)p);
+        __m128i hits = _mm_or_si128(_mm_cmpeq_epi8(chunk, colon), _mm_cmpeq_epi8(chunk, cr));
+        int mask = _mm_movemask_epi8(hits);
+        if (mask) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+#endif
+    while (p < end) {
+        if (*p == ':' || *p == '\r') {
+            return p;
+        }
+        p++;
+    }
+    return NULL;
+}
+
+static http_slice_t trim_slice(const char* start, const char* end) {
+    while (start < end && (*start == ' ' || *start == '\t')) {
+        start++;
+    }
+    while (end > start && (end[-1] == ' ' || end[-1] == '\t')) {
+        end--;
+    }
+
+    http_slice_t slice = { start, (size_t)(end - start) };
+    return slice;
+}
+
+static int parse_content_length(http_slice_t value, size_t* out) {
+    if (value.len == 0 || value.len > 18) {
+        return -1;
+    }
+
+    size_t result = 0;
+    for (size_t i = 0; i < value.len; i++) {
+        if (value.data[i] < '0' || value.data[i] > '9') {
+            return -1;
+        }
+        result = result * 10 + (size_t)(value.data[i] - '0');
+    }
+
+    *out = result;
+    return 0;
+}
+
+static int parse_request_line(http_request_t* request, const char* line, const char* line_end) {
+    const char* method_end = scan_byte(line, line_end, ' ');
+    if (!method_end || method_end == line) {
+        return -1;
+    }
+
+    const char* target = method_end + 1;
+    const char* target_end = scan_byte(target, line_end, ' ');
+    if (!target_end || target_end == target || *target != '/') {
+        return -1;
+    }
+
+    const char* version = target_end + 1;
+    if (line_end - version != 8 || memcmp(version, "HTTP/1.", 7) != 0 ||
+        (version[7] != '0' && version[7] != '1')) {
+        return -1;
+    }
+
+    request->method.data = line;
+    request->method.len = method_end - line;
+    request->minor_version = version[7] - '0';
+
+    const char* query = scan_byte(target, target_end, '?');
+    request->path.data = target;
+    request->path.len = (query ? query : target_end) - target;
+    if (query) {
+        request->query.data = query + 1;
+        request->query.len = target_end - (query + 1);
+    }
+    return 0;
+}
+
+static int parse_head(http_request_t* request, const char* buffer) {
+    const char* end = buffer + request->header_len - 2;
+    const char* line_end = scan_byte(buffer, end, '\r');
+    if (!line_end || parse_request_line(request, buffer, line_end) < 0) {
+        return -1;
+    }
+
+    request->header_count = 0;
+    request->content_length = 0;
+    request->chunked = false;
+    bool has_length = false;
+
+    const char* line = line_end + 2;
+    while (line < end) {
+        const char* delimiter = scan_header_delimiter(line, end);
+        if (!delimiter || *delimiter != ':' || delimiter == line ||
+            request->header_count >= HTTP_MAX_HEADERS) {
+            return -1;
+        }
+
+        const char* value_end = scan_byte(delimiter + 1, end, '\r');
+        if (!value_end || value_end[1] != '\n') {
+            return -1;
+        }
+
+        http_header_t* header = &request->headers[request->header_count++];
+        header->name.data = line;
+        header->name.len = delimiter - line;
+        header->value = trim_slice(delimiter + 1, value_end);
+
+        if (header->name.len == 14 && strncasecmp(line, "Content-Length", 14) == 0) {
+            size_t length;
+            if (parse_content_length(header->value, &length) < 0 ||
+                (has_length && length != request->content_length)) {
+                return -1;
+            }
+            request->content_length = length;
+            has_length = true;
+        } else if (header->name.len == 17 && strncasecmp(line, "Transfer-Encoding", 17) == 0) {
+            request->chunked = true;
+        }
+
+        line = value_end + 2;
+    }
+
+    if (request->chunked) {
+        request->content_length = 0;
+    }
+
+    request->base = buffer;
+    return 0;
+}
+
+void init_http_request(http_request_t* request) {
+    memset(request, 0, sizeof(http_request_t));
+}
+
+/*
+ * Returns 1 once the full request (head and Content-Length body) is buffered,
+ * 0 if more bytes are needed and -1 for a malformed request. Call again with
+ * the same request after every read; scanning resumes where it stopped.
+ */
+int parse_http_request(http_request_t* request, const char* buffer, size_t length) {
+    if (request->header_len == 0) {
+        const char* end = buffer + length;
+        const char* p = buffer + request->scan_offset;
+
+        for (;;) {
+            p = scan_byte(p, end, '\r');
+            if (!p) {
+                request->scan_offset = length;
+                return 0;
+            }
+            if (end - p < 4) {
+                request->scan_offset = p - buffer;
+                return 0;
+            }
+            if (memcmp(p, "\r\n\r\n", 4) == 0) {
+                break;
+            }
+            p++;
+        }
+
+        request->header_len = (p + 4) - buffer;
+        if (parse_head(request, buffer) < 0) {
+            return -1;
+        }
+    } else if (request->base != buffer && parse_head(request, buffer) < 0) {
+        return -1;
+    }
+
+    if (length - request->header_len < request->content_length) {
+        return 0;
+    }
+
+    request->body.data = buffer + request->header_len;
+    request->body.len = request->content_length;
+    return 1;
+}
+
+size_t http_request_length(const http_request_t* request) {
+    return request->header_len + request->content_length;
+}
+
+const http_slice_t* find_http_header(const http_request_t* request, const char* name) {
+    size_t name_len = strlen(name);
+    for (int i = 0; i < request->header_count; i++) {
+        const http_header_t* header = &request->headers[i];
+        if (header->name.len == name_len && strncasecmp(header->name.data, name, name_len) == 0) {
+            return &header->value;
+        }
+    }
+    return NULL;
+}
+
+bool http_header_has_token(const http_request_t* request, const char* name, const char* token) {
+    size_t name_len = strlen(name);
+    size_t token_len = strlen(token);
+
+    for (int i = 0; i < request->header_count; i++) {
+        const http_header_t* header = &request->headers[i];
+        if (header->name.len != name_len || strncasecmp(header->name.data, name, name_len) != 0) {
+            continue;
+        }
+
+        const char* p = header->value.data;
+        const char* end = p + header->value.len;
+        while (p < end) {
+            const char* comma = scan_byte(p, end, ',');
+            const char* item_end = comma ? comma : end;
+            http_slice_t item = trim_slice(p, item_end);
+            if (item.len == token_len && strncasecmp(item.data, token, token_len) == 0) {
+                return true;
+            }
+            p = item_end + 1;
+        }
+    }
+    return false;
+}
+
+// True unless the parameters carry a q-value of zero
+static bool quality_nonzero(const char* params, const char* end) {
+    while ((params = scan_byte(params, end, ';'))) {
+        http_slice_t param = trim_slice(params + 1, end);
+        if (param.len >= 2 && (param.data[0] == 'q' || param.data[0] == 'Q') && param.data[1] == '=') {
+            for (size_t i = 2; i < param.len && param.data[i] != ';'; i++) {
+                if (param.data[i] >= '1' && param.data[i] <= '9') {
+                    return true;
+                }
+            }
+            return false;
+        }
+        params++;
+    }
+    return true;
+}
+
+bool http_header_accepts(const http_request_t* request, const char* name, const char* token) {
+    size_t name_len = strlen(name);
+    size_t token_len = strlen(token);
+    int wildcard = -1;
+
+    for (int i = 0; i < request->header_count; i++) {
+        const http_header_t* header = &request->headers[i];
+        if (header->name.len != name_len || strncasecmp(header->name.data, name, name_len) != 0) {
+            continue;
+        }
+
+        const char* p = header->value.data;
+        const char* end = p + header->value.len;
+        while (p < end) {
+            const char* comma = scan_byte(p, end, ',');
+            const char* item_end = comma ? comma : end;
+            const char* semicolon = scan_byte(p, item_end, ';');
+            http_slice_t item = trim_slice(p, semicolon ? semicolon : item_end);
+            bool allowed = quality_nonzero(semicolon ? semicolon : item_end, item_end);
+
+            if (item.len == token_len && strncasecmp(item.data, token, token_len) == 0) {
+                return allowed;
+            }
+            if (item.len == 1 && item.data[0] == '*') {
+                wildcard = allowed;
+            }
+            p = item_end + 1;
+        }
+    }
+    return wildcard == 1;
+}
+
+bool http_slice_equals(http_slice_t slice, const char* text) {
+    size_t text_len = strlen(text);
+    return slice.len == text_len && memcmp(slice.data, text, text_len) == 0;
+}
+
+int http_slice_copy(http_slice_t slice, char* out, size_t out_size) {
+    if (slice.len >= out_size) {
+        return -1;
+    }
+
+    memcpy(out, slice.data, slice.len);
+    out[slice.len] = '\0';
+    return (int)slice.len;
+}
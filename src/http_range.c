@@ -0,0 +1,161 @@
+#include "http_range.h"
+#include "admission.h"
+#include "http_cache.h"
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+static bool parse_offset(const char** p, const char* end, size_t* value) {
+    if (*p >= end || **p < '0' || **p > '9') {
+        return false;
+    }
+
+    size_t result = 0;
+    while (*p < end && **p >= '0' && **p <= '9') {
+        size_t next = result * 10 + (size_t)(**p - '0');
+        if (next / 10 != result) {
+            return false;
+        }
+        result = next;
+        (*p)++;
+    }
+    *value = result;
+    return true;
+}
+
+static void skip_spaces(const char** p, const char* end) {
+    while (*p < end && (**p == ' ' || **p == '\t')) {
+        (*p)++;
+    }
+}
+
+range_result_t parse_byte_ranges(const http_request_t* request, size_t size, byte_range_t* ranges, int* count) {
+    const http_slice_t* header = find_http_header(request, "Range");
+    *count = 0;
+    if (!header || header->len < 6 || strncmp(header->data, "bytes=", 6) != 0) {
+        return RANGE_NONE;
+    }
+
+    const char* p = header->data + 6;
+    const char* end = header->data + header->len;
+    int specs = 0;
+    while (p < end) {
+        size_t first = 0, last = SIZE_MAX;
+        skip_spaces(&p, end);
+        if (p < end && *p == ',') {
+            p++;
+            continue;
+        }
+
+        bool suffix = p < end && *p == '-';
+        if (!suffix && !parse_offset(&p, end, &first)) {
+            return RANGE_NONE;
+        }
+        if (p >= end || *p != '-') {
+            return RANGE_NONE;
+        }
+        p++;
+        if (p < end && *p >= '0' && *p <= '9' && !parse_offset(&p, end, &last)) {
+            return RANGE_NONE;
+        }
+        if ((suffix && last == SIZE_MAX) || (!suffix && last < first)) {
+            return RANGE_NONE;
+        }
+        skip_spaces(&p, end);
+        if (p < end && *p != ',') {
+            return RANGE_NONE;
+        }
+
+        // Too many ranges is not worth honouring, the whole file is cheaper
+        if (++specs > RANGE_MAX_PARTS) {
+            *count = 0;
+            return RANGE_NONE;
+        }
+        if (suffix) {
+            if (last == 0 || size == 0) {
+                continue;
+            }
+            first = last >= size ? 0 : size - last;
+            last = size - 1;
+        } else if (first >= size) {
+            continue;
+        } else if (last >= size) {
+            last = size - 1;
+        }
+        ranges[*count].start = first;
+        ranges[*count].length = last - first + 1;
+        (*count)++;
+    }
+
+    if (specs == 0) {
+        return RANGE_NONE;
+    }
+    return *count > 0 ? RANGE_SATISFIABLE : RANGE_UNSATISFIABLE;
+}
+
+// If-Range needs an exact match, so weak tags never qualify
+bool if_range_matches(const http_request_t* request, const char* etag, time_t mtime) {
+    const http_slice_t* header = find_http_header(request, "If-Range");
+    if (!header) {
+        return true;
+    }
+
+    if (header->len > 0 && header->data[0] == '"') {
+        return etag && http_slice_equals(*header, etag);
+    }
+
+    char date[HTTP_DATE_SIZE];
+    format_http_date(date, sizeof(date), mtime);
+    return mtime > 0 && http_slice_equals(*header, date);
+}
+
+void format_range_boundary(char* buffer, size_t size) {
+    long long now = monotonic_us();
+    snprintf(buffer, size, "blink-%016llx", (unsigned long long)xxh64(&now, sizeof(now), (uint64_t)(uintptr_t)buffer));
+}
+
+static int format_part_header(char* buffer, size_t buffer_size, const byte_range_t* range, size_t size,
+                              const char* content_type, const char* boundary) {
+    return snprintf(buffer, buffer_size, "\r\n--%s\r\nContent-Type: %s\r\nContent-Range: bytes %zu-%zu/%zu\r\n\r\n",
+                    boundary, content_type, range->start, range->start + range->length - 1, size);
+}
+
+char* read_multipart_ranges(int fd, size_t size, const byte_range_t* ranges, int count,
+                            const char* content_type, const char* boundary, size_t* length) {
+    size_t total = strlen(boundary) + 8;
+    for (int i = 0; i < count; i++) {
+        total += (size_t)format_part_header(NULL, 0, &ranges[i], size, content_type, boundary) + ranges[i].length;
+        if (total > RANGE_MULTIPART_MAX) {
+            return NULL;
+        }
+    }
+
+    char* body = malloc(total + 1);
+    if (!body) {
+        return NULL;
+    }
+
+    size_t used = 0;
+    for (int i = 0; i < count; i++) {
+        used += format_part_header(body + used, total + 1 - used, &ranges[i], size, content_type, boundary);
+        size_t done = 0;
+        while (done < ranges[i].length) {
+            ssize_t n = pread(fd, body + used + done, ranges[i].length - done, (off_t)(ranges[i].start + done));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                free(body);
+                return NULL;
+            }
+            done += (size_t)n;
+        }
+        used += done;
+    }
+    used += snprintf(body + used, total + 1 - used, "\r\n--%s--\r\n", boundary);
+
+    *length = used;
+    return body;
+}
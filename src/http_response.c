@@ -0,0 +1,178 @@
+#include "http_response.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/sendfile.h>
+
+#define STRINGIFY(x) #x
+#define TO_STRING(x) STRINGIFY(x)
+
+static const char KEEP_ALIVE_BLOCK[] = "Connection: keep-alive\r\n"
+                                       "Keep-Alive: timeout=" TO_STRING(KEEPALIVE_TIMEOUT_SEC) "\r\n"
+                                       "\r\n";
+static const char CLOSE_BLOCK[] = "Connection: close\r\n"
+                                  "\r\n";
+
+void init_http_response(http_response_t* response, bool keep_alive) {
+    memset(response->iov, 0, sizeof(struct iovec) * RESPONSE_HEAD_IOVS);
+    response->iov_count = RESPONSE_HEAD_IOVS;
+    response->owned_count = 0;
+    response->extra_len = 0;
+    response->body_length = 0;
+    response->length = 0;
+    response->file_fd = -1;
+    response->file_offset = 0;
+    response->file_length = 0;
+    response->held = NULL;
+    response->release_held = NULL;
+    response->keep_alive = keep_alive;
+}
+
+int http_response_add_header(http_response_t* response, const char* name, const char* value) {
+    size_t space = RESPONSE_EXTRA_HEADERS_SIZE - response->extra_len;
+    int written = snprintf(response->extra_headers + response->extra_len, space, "%s: %s\r\n", name, value);
+    if (written < 0 || (size_t)written >= space) {
+        response->extra_headers[response->extra_len] = '\0';
+        return -1;
+    }
+
+    response->extra_len += written;
+    return 0;
+}
+
+int http_response_add_body(http_response_t* response, const char* data, size_t length) {
+    if (length == 0) {
+        return 0;
+    }
+    if (response->iov_count >= RESPONSE_MAX_IOVS) {
+        return -1;
+    }
+
+    response->iov[response->iov_count].iov_base = (void*)data;
+    response->iov[response->iov_count].iov_len = length;
+    response->iov_count++;
+    response->body_length += length;
+    return 0;
+}
+
+int http_response_own(http_response_t* response, char* buffer) {
+    if (response->owned_count >= RESPONSE_MAX_OWNED) {
+        return -1;
+    }
+
+    response->owned[response->owned_count++] = buffer;
+    return 0;
+}
+
+int http_response_hold(http_response_t* response, void* object, http_release_fn release) {
+    if (response->held) {
+        return -1;
+    }
+
+    response->held = object;
+    response->release_held = release;
+    return 0;
+}
+
+int http_response_add_file(http_response_t* response, int fd, off_t offset, size_t length) {
+    if (response->file_fd >= 0) {
+        return -1;
+    }
+
+    response->file_fd = fd;
+    response->file_offset = offset;
+    response->file_length = length;
+    response->body_length += length;
+    return 0;
+}
+
+int finish_http_response(http_response_t* response, const char* status, const char* headers) {
+    int head_len;
+    // A 304 has no body, and a Content-Length would describe the one it replaces
+    if (strncmp(status, "304", 3) == 0) {
+        head_len = snprintf(response->head, sizeof(response->head), "HTTP/1.1 %s\r\n", status);
+    } else {
+        head_len = snprintf(response->head, sizeof(response->head),
+                            "HTTP/1.1 %s\r\nContent-Length: %zu\r\n", status, response->body_length);
+    }
+    if (head_len < 0 || (size_t)head_len >= sizeof(response->head)) {
+        response->length = 0;
+        return -1;
+    }
+
+    const char* connection = response->keep_alive ? KEEP_ALIVE_BLOCK : CLOSE_BLOCK;
+    size_t connection_len = response->keep_alive ? sizeof(KEEP_ALIVE_BLOCK) - 1 : sizeof(CLOSE_BLOCK) - 1;
+
+    response->iov[0].iov_base = response->head;
+    response->iov[0].iov_len = head_len;
+    response->iov[1].iov_base = (void*)headers;
+    response->iov[1].iov_len = headers ? strlen(headers) : 0;
+    response->iov[2].iov_base = response->extra_headers;
+    response->iov[2].iov_len = response->extra_len;
+    response->iov[3].iov_base = (void*)connection;
+    response->iov[3].iov_len = connection_len;
+
+    response->length = response->file_length;
+    for (int i = 0; i < response->iov_count; i++) {
+        response->length += response->iov[i].iov_len;
+    }
+    return 0;
+}
+
+// HEAD: the finished head goes out as is, Content-Length included, and nothing after it
+void http_response_drop_body(http_response_t* response) {
+    if (response->length == 0) {
+        return;
+    }
+
+    response->length -= response->file_length;
+    for (int i = RESPONSE_HEAD_IOVS; i < response->iov_count; i++) {
+        response->length -= response->iov[i].iov_len;
+    }
+    response->iov_count = RESPONSE_HEAD_IOVS;
+    response->file_fd = -1;
+    response->file_length = 0;
+}
+
+void set_static_http_response(http_response_t* response, const char* data) {
+    init_http_response(response, false);
+    http_response_add_body(response, data, strlen(data));
+    response->length = response->body_length;
+}
+
+int http_response_pending_iov(const http_response_t* response, size_t sent, struct iovec* out) {
+    int count = 0;
+    for (int i = 0; i < response->iov_count; i++) {
+        size_t len = response->iov[i].iov_len;
+        if (sent >= len) {
+            sent -= len;
+            continue;
+        }
+
+        out[count].iov_base = (char*)response->iov[i].iov_base + sent;
+        out[count].iov_len = len - sent;
+        sent = 0;
+        count++;
+    }
+    return count;
+}
+
+ssize_t http_response_send_file(const http_response_t* response, int socket, size_t sent) {
+    size_t head_length = response->length - response->file_length;
+    off_t offset = response->file_offset + (off_t)(sent - head_length);
+    return sendfile(socket, response->file_fd, &offset, response->length - sent);
+}
+
+void free_http_response(http_response_t* response) {
+    if (!response) {
+        return;
+    }
+
+    for (int i = 0; i < response->owned_count; i++) {
+        free(response->owned[i]);
+    }
+    if (response->held) {
+        response->release_held(response->held);
+    }
+    init_http_response(response, response->keep_alive);
+}
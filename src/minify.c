@@ -0,0 +1,117 @@
+#define _GNU_SOURCE
+#include "minify.h"
+#include <ctype.h>
+#include <string.h>
+#include <strings.h>
+
+static const char* raw_elements[] = { "pre", "textarea", "script", "style" };
+
+static bool minify_on = false;
+
+void configure_minify(bool enabled) {
+    minify_on = enabled;
+}
+
+bool minify_applies(const char* path) {
+    const char* dot = strrchr(path, '.');
+    return minify_on && dot && !strchr(dot, '/') && strcasecmp(dot, ".html") == 0;
+}
+
+static bool is_space(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
+
+// Name of the raw element whose start tag begins at html[pos], if any
+static const char* raw_element_at(const char* html, size_t pos, size_t length) {
+    for (size_t i = 0; i < sizeof(raw_elements) / sizeof(raw_elements[0]); i++) {
+        size_t n = strlen(raw_elements[i]);
+        if (pos + 1 + n < length && strncasecmp(html + pos + 1, raw_elements[i], n) == 0 &&
+            (is_space(html[pos + 1 + n]) || html[pos + 1 + n] == '>' || html[pos + 1 + n] == '/')) {
+            return raw_elements[i];
+        }
+    }
+    return NULL;
+}
+
+// Offset just past the end tag of a raw element, or length if it never closes
+static size_t raw_element_end(const char* html, size_t pos, size_t length, const char* name) {
+    size_t n = strlen(name);
+    for (size_t i = pos; i + 2 + n <= length; i++) {
+        if (html[i] == '<' && html[i + 1] == '/' && strncasecmp(html + i + 2, name, n) == 0) {
+            const char* close = memchr(html + i, '>', length - i);
+            return close ? (size_t)(close - html) + 1 : length;
+        }
+    }
+    return length;
+}
+
+static size_t find_end(const char* html, size_t pos, size_t length, const char* marker) {
+    size_t n = strlen(marker);
+    const char* found = memmem(html + pos, length - pos, marker, n);
+    return found ? (size_t)(found - html) + n : length;
+}
+
+// In place: the output is never longer than what has been read
+size_t minify_html(char* html, size_t length) {
+    size_t r = 0, w = 0;
+    bool in_tag = false;
+    char quote = 0;
+
+    while (r < length) {
+        char c = html[r];
+        size_t end = 0;
+
+        if (quote) {
+            quote = c == quote ? 0 : quote;
+            html[w++] = html[r++];
+            continue;
+        }
+
+        if (c == '{' && r + 1 < length && (html[r + 1] == '%' || html[r + 1] == '{')) {
+            end = find_end(html, r + 2, length, html[r + 1] == '%' ? "%}" : "}}");
+        } else if (in_tag && (c == '"' || c == '\'')) {
+            quote = c;
+        } else if (in_tag && c == '>') {
+            in_tag = false;
+        } else if (c == '<' && r + 4 <= length && memcmp(html + r, "<!--", 4) == 0) {
+            // Conditional comments and template directives are content
+            if ((r + 4 < length && html[r + 4] == '[') ||
+                (r + 14 <= length && memcmp(html + r + 4, " template:", 10) == 0)) {
+                end = find_end(html, r + 4, length, "-->");
+            } else {
+                r = find_end(html, r + 4, length, "-->");
+                continue;
+            }
+        } else if (c == '<' && !in_tag) {
+            const char* raw = raw_element_at(html, r, length);
+            if (raw) {
+                const char* open_end = memchr(html + r, '>', length - r);
+                end = open_end ? raw_element_end(html, (size_t)(open_end - html) + 1, length, raw) : length;
+            } else if (r + 1 < length && (isalpha((unsigned char)html[r + 1]) || html[r + 1] == '/' || html[r + 1] == '!')) {
+                in_tag = true;
+            }
+        } else if (is_space(c)) {
+            bool newline = false;
+            while (r < length && is_space(html[r])) {
+                newline |= html[r] == '\n';
+                r++;
+            }
+            // A dropped comment can leave two runs side by side
+            if (w > 0 && !is_space(html[w - 1])) {
+                html[w++] = newline && !in_tag ? '\n' : ' ';
+            }
+            continue;
+        }
+
+        if (end) {
+            memmove(html + w, html + r, end - r);
+            w += end - r;
+            r = end;
+        } else {
+            html[w++] = html[r++];
+        }
+    }
+
+    html[w] = '\0';
+    return w;
+}
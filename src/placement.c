@@ -0,0 +1,172 @@
+#define _GNU_SOURCE
+#include "placement.h"
+#include "websocket.h"
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+static cpu_set_t role_cpus[PLACEMENT_ROLES];
+static bool role_configured[PLACEMENT_ROLES];
+
+static const char* role_names[PLACEMENT_ROLES] = {
+    "event loops",
+    "workers",
+    "housekeeping"
+};
+
+static int parse_cpu_list(const char* list, cpu_set_t* set) {
+    const char* p = list;
+    CPU_ZERO(set);
+
+    while (*p) {
+        char* end;
+        long first = strtol(p, &end, 10);
+        if (end == p) {
+            return -1;
+        }
+        long last = first;
+        p = end;
+        if (*p == '-') {
+            last = strtol(p + 1, &end, 10);
+            if (end == p + 1) {
+                return -1;
+            }
+            p = end;
+        }
+        if (first < 0 || last < first || last >= CPU_SETSIZE) {
+            return -1;
+        }
+        for (long cpu = first; cpu <= last; cpu++) {
+            CPU_SET(cpu, set);
+        }
+
+        if (*p == ',') {
+            p++;
+        } else if (*p) {
+            return -1;
+        }
+    }
+    return CPU_COUNT(set) > 0 ? 0 : -1;
+}
+
+int configure_placement(placement_role_t role, const char* cpu_list) {
+    if (parse_cpu_list(cpu_list, &role_cpus[role]) != 0) {
+        return -1;
+    }
+    role_configured[role] = true;
+    return 0;
+}
+
+int init_placement(void) {
+    cpu_set_t available;
+    if (sched_getaffinity(0, sizeof(available), &available) != 0) {
+        perror("sched_getaffinity failed");
+        return -1;
+    }
+
+    for (int role = 0; role < PLACEMENT_ROLES; role++) {
+        if (!role_configured[role]) {
+            continue;
+        }
+        CPU_AND(&role_cpus[role], &role_cpus[role], &available);
+        if (CPU_COUNT(&role_cpus[role]) == 0) {
+            fprintf(stderr, "%s%s[ERROR] %sNo usable CPUs in the %s set%s\n",
+                    BOLD, COLOR_RED, COLOR_RESET, role_names[role], COLOR_RESET);
+            return -1;
+        }
+    }
+
+    cpu_set_t hot_path = available;
+    if (role_configured[PLACEMENT_HOUSEKEEPING]) {
+        cpu_set_t isolated;
+        CPU_XOR(&isolated, &available, &role_cpus[PLACEMENT_HOUSEKEEPING]);
+        CPU_AND(&isolated, &isolated, &available);
+        if (CPU_COUNT(&isolated) > 0) {
+            hot_path = isolated;
+        }
+    } else {
+        role_cpus[PLACEMENT_HOUSEKEEPING] = available;
+    }
+    if (!role_configured[PLACEMENT_LOOP]) {
+        role_cpus[PLACEMENT_LOOP] = hot_path;
+    }
+    if (!role_configured[PLACEMENT_WORKER]) {
+        role_cpus[PLACEMENT_WORKER] = hot_path;
+    }
+
+    if (role_configured[PLACEMENT_HOUSEKEEPING]) {
+        place_thread(PLACEMENT_HOUSEKEEPING, -1);
+    }
+    return 0;
+}
+
+bool placement_configured(placement_role_t role) {
+    return role_configured[role];
+}
+
+int placement_cpu(placement_role_t role, int index) {
+    int count = CPU_COUNT(&role_cpus[role]);
+    if (count == 0) {
+        return -1;
+    }
+
+    int skip = index % count;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &role_cpus[role]) && skip-- == 0) {
+            return cpu;
+        }
+    }
+    return -1;
+}
+
+int place_thread(placement_role_t role, int cpu) {
+    cpu_set_t cpus = role_cpus[role];
+    if (cpu >= 0) {
+        CPU_ZERO(&cpus);
+        CPU_SET(cpu, &cpus);
+    }
+    if (CPU_COUNT(&cpus) == 0) {
+        return -1;
+    }
+
+    int result = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    if (result != 0) {
+        fprintf(stderr, "%s%s[WARNING] %sFailed to place %s thread: %s%s\n",
+                BOLD, COLOR_YELLOW, COLOR_RESET, role_names[role], strerror(result), COLOR_RESET);
+        return -1;
+    }
+
+    // Overrides an inherited interleave policy; fails harmlessly without NUMA
+    syscall(SYS_set_mempolicy, MPOL_LOCAL, NULL, 0);
+    return 0;
+}
+
+int format_placement(placement_role_t role, char* buffer, size_t size) {
+    const cpu_set_t* cpus = &role_cpus[role];
+    int written = 0;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (!CPU_ISSET(cpu, cpus)) {
+            continue;
+        }
+        int last = cpu;
+        while (last + 1 < CPU_SETSIZE && CPU_ISSET(last + 1, cpus)) {
+            last++;
+        }
+
+        int n = last == cpu
+            ? snprintf(buffer + written, size - written, "%s%d", written ? "," : "", cpu)
+            : snprintf(buffer + written, size - written, "%s%d-%d", written ? "," : "", cpu, last);
+        if (n < 0 || (size_t)n >= size - written) {
+            return -1;
+        }
+        written += n;
+        cpu = last;
+    }
+    return written;
+}
@@ -0,0 +1,146 @@
+#include "rate_limit.h"
+#include "admission.h"
+#include <stdio.h>
+
+#define MILLI_TOKENS 1000ULL
+#define MAX_BURST 1000000
+
+static rate_limiter_t limiters[RATE_LIMIT_KINDS];
+
+static const char* rate_limit_names[RATE_LIMIT_KINDS] = {
+    "rate_limited_http",
+    "rate_limited_ws"
+};
+
+static uint32_t clock_ms(void) {
+    uint32_t now = (uint32_t)(monotonic_us() / 1000);
+    return now ? now : 1;
+}
+
+static uint64_t mix_key(uint64_t key) {
+    key ^= key >> 30;
+    key *= 0xbf58476d1ce4e5b9ULL;
+    key ^= key >> 27;
+    key *= 0x94d049bb133111ebULL;
+    key ^= key >> 31;
+    return key;
+}
+
+static uint64_t refilled_tokens(const rate_limiter_t* limiter, uint64_t state, uint32_t now) {
+    uint64_t capacity = limiter->burst * MILLI_TOKENS;
+    if (state == 0) {
+        return capacity;
+    }
+
+    uint32_t elapsed = now - (uint32_t)state;
+    uint64_t tokens = (state >> 32) + (uint64_t)elapsed * limiter->rate;
+    return tokens < capacity ? tokens : capacity;
+}
+
+static rate_bucket_t* find_bucket(rate_limiter_t* limiter, uint64_t key, uint32_t now, bool claim) {
+    uint64_t hash = mix_key(key);
+    rate_bucket_t* shard = limiter->buckets[hash >> 58];
+    unsigned start = (unsigned)hash;
+
+    for (unsigned probe = 0; probe < RATE_LIMIT_PROBES; probe++) {
+        rate_bucket_t* bucket = &shard[(start + probe) & (RATE_LIMIT_SHARD_SLOTS - 1)];
+        if (atomic_load_explicit(&bucket->key, memory_order_acquire) == key) {
+            return bucket;
+        }
+    }
+    if (!claim) {
+        return NULL;
+    }
+
+    uint64_t capacity = limiter->burst * MILLI_TOKENS;
+    for (unsigned probe = 0; probe < RATE_LIMIT_PROBES; probe++) {
+        rate_bucket_t* bucket = &shard[(start + probe) & (RATE_LIMIT_SHARD_SLOTS - 1)];
+        uint_fast64_t current = atomic_load_explicit(&bucket->key, memory_order_acquire);
+        if (current == key) {
+            return bucket;
+        }
+
+        uint64_t state = atomic_load_explicit(&bucket->state, memory_order_relaxed);
+        if (current != 0 && refilled_tokens(limiter, state, now) < capacity) {
+            continue;
+        }
+        if (atomic_compare_exchange_strong(&bucket->key, &current, key)) {
+            atomic_store_explicit(&bucket->state, 0, memory_order_release);
+            return bucket;
+        }
+    }
+    return NULL;
+}
+
+void configure_rate_limit(rate_limit_kind_t kind, int rate, int burst) {
+    rate_limiter_t* limiter = &limiters[kind];
+    limiter->rate = rate > 0 ? (uint64_t)rate : 0;
+    limiter->burst = burst > 0 ? (uint64_t)burst : limiter->rate * 2;
+    if (limiter->burst > MAX_BURST) {
+        limiter->burst = MAX_BURST;
+    }
+}
+
+bool rate_limit_enabled(rate_limit_kind_t kind) {
+    return limiters[kind].rate > 0;
+}
+
+bool rate_limit_allow(rate_limit_kind_t kind, uint64_t key) {
+    rate_limiter_t* limiter = &limiters[kind];
+    if (limiter->rate == 0 || key == 0) {
+        return true;
+    }
+
+    uint32_t now = clock_ms();
+    rate_bucket_t* bucket = find_bucket(limiter, key, now, true);
+    if (!bucket) {
+        return true;
+    }
+
+    uint_fast64_t state = atomic_load_explicit(&bucket->state, memory_order_acquire);
+    for (;;) {
+        uint64_t tokens = refilled_tokens(limiter, state, now);
+        if (tokens < MILLI_TOKENS) {
+            atomic_fetch_add_explicit(&limiter->rejected, 1, memory_order_relaxed);
+            return false;
+        }
+
+        uint64_t next = ((tokens - MILLI_TOKENS) << 32) | now;
+        if (atomic_compare_exchange_weak(&bucket->state, &state, next)) {
+            return true;
+        }
+    }
+}
+
+bool rate_limit_exhausted(rate_limit_kind_t kind, uint64_t key) {
+    rate_limiter_t* limiter = &limiters[kind];
+    if (limiter->rate == 0 || key == 0) {
+        return false;
+    }
+
+    uint32_t now = clock_ms();
+    rate_bucket_t* bucket = find_bucket(limiter, key, now, false);
+    if (!bucket) {
+        return false;
+    }
+
+    uint64_t state = atomic_load_explicit(&bucket->state, memory_order_acquire);
+    if (refilled_tokens(limiter, state, now) >= MILLI_TOKENS) {
+        return false;
+    }
+    atomic_fetch_add_explicit(&limiter->rejected, 1, memory_order_relaxed);
+    return true;
+}
+
+int format_rate_limit_stats(char* buffer, size_t size) {
+    int written = 0;
+    for (int i = 0; i < RATE_LIMIT_KINDS; i++) {
+        int n = snprintf(buffer + written, size - written, "%s %lld\n", rate_limit_names[i],
+                         atomic_load_explicit(&limiters[i].rejected, memory_order_relaxed));
+        if (n < 0 || (size_t)n >= size - written) {
+            return -1;
+        }
+        written += n;
+    }
+    return written;
+}
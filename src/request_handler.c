@@ -1,31 +1,41 @@
 #include "request_handler.h"
 #include "websocket.h"
 #include "sqlite_handler.h"
+#include "admission.h"
+#include "rate_limit.h"
+#include "file_cache.h"
+#include "fd_cache.h"
+#include "static_files.h"
+#include "compression.h"
+#include "http_cache.h"
+#include "http_range.h"
+#include "coroutine.h"
+#include "debug.h"
+#include "route_table.h"
+#ifdef BLINK_EMBED_WWW
+#include "embedded_files.h"
+#endif
 
 bool enable_templates = true;
 char* custom_html_file = NULL;
 int server_port = PORT;
 const char* default_html_file = "index.html";
+static bool stats_enabled = false;
+static char* stored_form_result = NULL;
+static pthread_mutex_t form_result_mutex = PTHREAD_MUTEX_INITIALIZER;
 
-char* parse_form_data(const char* buffer, size_t buffer_size) {
-    const char* body_start = strstr(buffer, "\r\n\r\n");
-    if (!body_start) {
-        return NULL;
-    }
-    
-    body_start += 4;
-    size_t body_length = buffer_size - (body_start - buffer);
-    if (body_length <= 0) {
+char* parse_form_data(const http_request_t* request) {
+    if (request->body.len == 0) {
         return NULL;
     }
  
-    char* form_data = malloc(body_length + 1);
+    char* form_data = malloc(request->body.len + 1);
     if (!form_data) {
         return NULL;
     }
     
-    memcpy(form_data, body_start, body_length);
-    form_data[body_length] = '\0';
+    memcpy(form_data, request->body.data, request->body.len);
+    form_data[request->body.len] = '\0';
     
     return form_data;
 }
@@ -164,8 +174,8 @@ char* handle_sql_form(const char* form_data) {
             form_ptr++;
         }
         
-        printf("%s%s[SQLite] %sExecuting form %s query: %s%s\n", 
-               BOLD, COLOR_BLUE, COLOR_RESET, sql_action, COLOR_CYAN, sql_query);
+        REQUEST_LOG("%s%s[SQLite] %sExecuting form %s query: %s%s\n", 
+                    BOLD, COLOR_BLUE, COLOR_RESET, sql_action, COLOR_CYAN, sql_query);
         
         sqlite_result_t* result = execute_query(sql_query);
         if (result) {
@@ -206,30 +216,6 @@ char* handle_sql_form(const char* form_data) {
     return result_html ? result_html : strdup("<p>Error processing form</p>");
 }
 
-char* extract_method(const char* request) {
-    static char method[16];
-    
-    char* end_of_first_line = strstr(request, "\r\n");
-    if (!end_of_first_line) {
-        return NULL;
-    }
-    
-    size_t line_len = end_of_first_line - request;
-    char first_line[512];
-    if (line_len >= sizeof(first_line) - 1) {
-        return NULL;  
-    }
-    
-    strncpy(first_line, request, line_len);
-    first_line[line_len] = '\0';
-    
-    if (sscanf(first_line, "%15s", method) != 1) {
-        return NULL;
-    }
-    
-    return method;
-}
-
 void set_server_port(int port) {
     server_port = port;
     printf("%s%s[CONFIG] %sServer port set to: %d%s\n", 
@@ -270,199 +256,396 @@ bool has_template_features(const char* content) {
     return false;
 }
 
-int is_websocket_request(const char* buffer) {
-    return (strstr(buffer, "Upgrade: websocket") && strstr(buffer, "Connection: Upgrade"));
+int is_websocket_request(const http_request_t* request) {
+    return http_header_has_token(request, "Upgrade", "websocket") &&
+           http_header_has_token(request, "Connection", "Upgrade");
 }
 
-char* extract_path(const char* request) {
-    static char path[256];
-    
-    char* end_of_first_line = strstr(request, "\r\n");
-    if (!end_of_first_line) {
-        return NULL;
+static bool wants_keep_alive(const http_request_t* request) {
+    if (http_header_has_token(request, "Connection", "close")) {
+        return false;
     }
-    
-    size_t line_len = end_of_first_line - request;
-    char first_line[512];
-    if (line_len >= sizeof(first_line) - 1) {
-        return NULL;  
+    return request->minor_version == 1 || http_header_has_token(request, "Connection", "keep-alive");
+}
+
+static const char HTML_PAGE_HEADERS[] = "Content-Type: text/html; charset=UTF-8\r\n"
+                                        "Cache-Control: no-store, no-cache, must-revalidate, max-age=0\r\n"
+                                        "Pragma: no-cache\r\n"
+                                        "Access-Control-Allow-Origin: *\r\n";
+static const char HTML_REVALIDATE_HEADERS[] = "Content-Type: text/html; charset=UTF-8\r\n"
+                                              "Cache-Control: no-cache\r\n"
+                                              "Access-Control-Allow-Origin: *\r\n";
+static const char HTML_ERROR_HEADERS[] = "Content-Type: text/html\r\n";
+static const char STATS_HEADERS[] = "Content-Type: text/plain\r\n"
+                                    "Cache-Control: no-store\r\n";
+
+static void set_response(http_response_t* response, const char* status, const char* headers, const char* body) {
+    if (body) {
+        http_response_add_body(response, body, strlen(body));
     }
-    
-    strncpy(first_line, request, line_len);
-    first_line[line_len] = '\0';
-    
-    char method[16], http_version[16];
-    if (sscanf(first_line, "%15s %255s %15s", method, path, http_version) != 3) {
-        return NULL;
+    finish_http_response(response, status, headers);
+}
+
+static void release_cache_entry(void* entry) {
+    file_cache_release((file_cache_entry_t*)entry);
+}
+
+static const char* page_headers(void) {
+    return http_cache_enabled() ? HTML_REVALIDATE_HEADERS : HTML_PAGE_HEADERS;
+}
+
+// Adds ETag and Last-Modified; true when the client's copy is current and the body was dropped
+static bool check_validators(const http_request_t* request, http_response_t* response,
+                             const char* etag, time_t mtime) {
+    if (!http_cache_enabled()) {
+        return false;
     }
-    
-    return path;
+
+    bool fresh = request_not_modified(request, etag, mtime);
+    if (fresh) {
+        free_http_response(response);
+    }
+    http_response_add_header(response, "ETag", etag);
+    if (mtime > 0) {
+        char date[HTTP_DATE_SIZE];
+        format_http_date(date, sizeof(date), mtime);
+        http_response_add_header(response, "Last-Modified", date);
+    }
+    return fresh;
 }
 
-void handle_client(int new_socket) {
-    char buffer[BUFFER_SIZE * 4] = { 0 };
-    ssize_t bytes_read = read(new_socket, buffer, sizeof(buffer) - 1);
-    if (bytes_read <= 0) {
-        perror("Error reading from client socket");
-        close(new_socket);
-        return;
+// Takes over the caller's reference to the entry that owns the bytes
+static void send_cached_bytes(const http_request_t* request, http_response_t* response, file_cache_entry_t* entry,
+                              const char* data, size_t length, const char* etag, const char* encoding,
+                              const char* headers) {
+    bool fresh = check_validators(request, response, etag, entry->mtime);
+
+    if (fresh) {
+        file_cache_release(entry);
+    } else {
+        http_response_hold(response, entry, release_cache_entry);
+        http_response_add_body(response, data, length);
     }
-    
-    buffer[bytes_read] = '\0';
-    
-    if (is_websocket_request(buffer) && 
-        (strstr(buffer, "GET /ws") || strstr(buffer, "GET /socket"))) {
-        printf("%s%s[WebSocket] %sRequest detected, redirecting to WebSocket handler%s\n",
-               BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
-        handle_websocket_client(new_socket, ws_clients);
-        return;
+    http_response_add_header(response, "Vary", "Accept-Encoding");
+    if (encoding && !fresh) {
+        http_response_add_header(response, "Content-Encoding", encoding);
     }
-    
-    char* method = extract_method(buffer);
-    char* path = extract_path(buffer);
-    
-    if (method && path) {
-        printf("%s%s[HTTP] %s%s request: %s%s\n", 
-               BOLD, COLOR_GREEN, COLOR_RESET, method, path, COLOR_RESET);
+    set_response(response, fresh ? "304 Not Modified" : "200 OK", headers, NULL);
+}
+
+// Rendered page or raw file from the cache, compressed if the client allows
+static bool serve_cached_body(const http_request_t* request, file_cache_entry_t* entry, bool static_file,
+                              const char* headers, http_response_t* response) {
+    int state = atomic_load_explicit(&entry->variant_state, memory_order_acquire);
+    if (state == VARIANTS_NONE) {
+        return false;
     }
-    
-    if (path && strcmp(path, "/favicon.ico") == 0) {
-        close(new_socket);
-        return;
+
+    char etag[ETAG_SIZE];
+    uint64_t hash = entry->rendered ? entry->rendered_hash : entry->data_hash;
+    for (int i = 0; state == VARIANTS_READY && i < ENCODING_COUNT; i++) {
+        if (entry->variants[i] && http_header_accepts(request, "Accept-Encoding", encoding_token(i))) {
+            format_etag(etag, sizeof(etag), hash, encoding_token(i));
+            send_cached_bytes(request, response, entry, entry->variants[i], entry->variant_sizes[i], etag,
+                              encoding_token(i), headers);
+            return true;
+        }
     }
-    
-    bool is_sql_form = false;
-    char* form_result_html = NULL;
-    
-    if (method && strcmp(method, "POST") == 0 && 
-        path && strcmp(path, "/sql") == 0) {
-        
-        printf("%s%s[SQLite] %sReceived SQL form submission%s\n", 
-               BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
-        
-        char* form_data = parse_form_data(buffer, bytes_read);
-        if (form_data) {
-            is_sql_form = true;
-            form_result_html = handle_sql_form(form_data);
-            free(form_data);
-            
-            char* referer = NULL;
-            const char* referer_header = strstr(buffer, "Referer: ");
-            if (referer_header) {
-                referer_header += 9;
-                const char* referer_end = strstr(referer_header, "\r\n");
-                if (referer_end) {
-                    size_t referer_len = referer_end - referer_header;
-                    referer = malloc(referer_len + 1);
-                    if (referer) {
-                        memcpy(referer, referer_header, referer_len);
-                        referer[referer_len] = '\0';
-                    }
-                }
-            }
-            
-            char redirect_path[256] = "/";
-            if (referer) {
-                const char* protocol_end = strstr(referer, "://");
-                if (protocol_end) {
-                    const char* host_start = protocol_end + 3;
-                    const char* path_start = strchr(host_start, '/');
-                    if (path_start) {
-                        strncpy(redirect_path, path_start, sizeof(redirect_path) - 1);
-                        redirect_path[sizeof(redirect_path) - 1] = '\0';
-                    }
-                }
-                free(referer);
-            }
-            
-            static char* stored_form_result = NULL;
-            if (stored_form_result) {
-                free(stored_form_result);
-            }
-            stored_form_result = form_result_html;
-            
-            char redirect_response[512];
-            snprintf(redirect_response, sizeof(redirect_response),
-                     "HTTP/1.1 302 Found\r\n"
-                     "Location: %s\r\n"
-                     "Content-Length: 0\r\n"
-                     "Connection: close\r\n"
-                     "\r\n", redirect_path);
-            
-            write(new_socket, redirect_response, strlen(redirect_response));
-            close(new_socket);
-            return;
+
+    // A static file's identity body carries the same validator as when it is sent from its descriptor
+    if (static_file) {
+        format_file_etag(etag, sizeof(etag), entry->size, entry->mtime);
+        // Ranges are served from the descriptor, which If-Range matches against this same ETag
+        http_response_add_header(response, "Accept-Ranges", "bytes");
+    } else {
+        format_etag(etag, sizeof(etag), hash, NULL);
+    }
+    if (entry->rendered) {
+        send_cached_bytes(request, response, entry, entry->rendered, entry->rendered_size, etag, NULL, headers);
+    } else {
+        send_cached_bytes(request, response, entry, entry->data, entry->size, etag, NULL, headers);
+    }
+    return true;
+}
+
+#ifndef BLINK_EMBED_WWW
+static void release_open_file(void* entry) {
+    fd_cache_release((fd_cache_entry_t*)entry);
+}
+
+// On a cache miss *file is left open for the caller, and large files are never read into memory
+static bool serve_compressed_asset(const http_request_t* request, const char* path, const char* headers,
+                                   http_response_t* response, fd_cache_entry_t** file) {
+    char full_path[512];
+    char sibling[520];
+    if (static_asset_path(HTML_DIR, path, full_path, sizeof(full_path)) < 0) {
+        return false;
+    }
+
+    // Files compressed ahead of time win over the variants built here
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        if (!http_header_accepts(request, "Accept-Encoding", encoding_token(i))) {
+            continue;
+        }
+        snprintf(sibling, sizeof(sibling), "%s%s", full_path, encoding_extension(i));
+        file_cache_entry_t* entry = load_cached_file(sibling);
+        if (entry && !entry->missing) {
+            char etag[ETAG_SIZE];
+            format_etag(etag, sizeof(etag), entry->data_hash, encoding_token(i));
+            send_cached_bytes(request, response, entry, entry->data, entry->size, etag, encoding_token(i), headers);
+            return true;
         }
+        file_cache_release(entry);
     }
 
-    char html_file[256] = "index.html";
-    
-    if (custom_html_file) {
-        FILE* test_file = fopen(custom_html_file, "r");
-        if (test_file) {
-            fclose(test_file);
-            char* filename = strrchr(custom_html_file, '/');
-            if (filename) {
-                filename++; 
-                strncpy(html_file, filename, sizeof(html_file) - 1);
-            } else {
-                strncpy(html_file, custom_html_file, sizeof(html_file) - 1);
-            }
-            
-            printf("%s%s[HTTP] %sUsing custom HTML file: %s%s%s\n", 
-                   BOLD, COLOR_GREEN, COLOR_RESET, COLOR_CYAN, html_file, COLOR_RESET);
-        } else {
-            printf("%s%s[HTTP] %s%sCustom HTML file not found: %s, falling back to index.html%s\n", 
-                   BOLD, COLOR_RED, BOLD, COLOR_RESET, custom_html_file, COLOR_RESET);
+    file_cache_entry_t* asset = file_cache_lookup(full_path);
+    if (!asset) {
+        *file = open_static_asset(HTML_DIR, path);
+        if (!*file || (*file)->size > COMPRESS_MAX_SIZE || !file_cache_fits(full_path, (*file)->size)) {
+            return false;
         }
-    } else {
-        if (strcmp(path, "/advanced") == 0) {
-            strcpy(html_file, "advanced.html");
-        } else if (strcmp(path, "/") != 0 && strncmp(path, "/index", 6) != 0) {
-            char potential_file[256];
-            snprintf(potential_file, sizeof(potential_file), "%.*s.html", (int)strcspn(path + 1, "?#"), path + 1);
-            
-            char full_path[512];
-            snprintf(full_path, sizeof(full_path), "%s/%s", HTML_DIR, potential_file);
-            
-            FILE* test_file = fopen(full_path, "r");
-            if (test_file) {
-                fclose(test_file);
-                strcpy(html_file, potential_file);
-            }
+        asset = load_cached_file(full_path);
+    }
+    if (asset && asset->cached && !asset->missing && asset->size <= COMPRESS_MAX_SIZE) {
+        schedule_compression(asset);
+        if (serve_cached_body(request, asset, true, headers, response)) {
+            return true;
         }
     }
+    file_cache_release(asset);
+    return false;
+}
 
-    char file_path[512];
-    if (custom_html_file) {
-        if (custom_html_file[0] == '/') {
-            strncpy(file_path, custom_html_file, sizeof(file_path) - 1);
-        } 
-        else {
-            strncpy(file_path, custom_html_file, sizeof(file_path) - 1);
+typedef struct {
+    int fd;
+    size_t size;
+    const byte_range_t* ranges;
+    int count;
+    const char* content_type;
+    const char* boundary;
+    char* body;
+    size_t length;
+} multipart_job_t;
+
+static void run_multipart_job(void* arg) {
+    multipart_job_t* job = (multipart_job_t*)arg;
+    job->body = read_multipart_ranges(job->fd, job->size, job->ranges, job->count, job->content_type,
+                                      job->boundary, &job->length);
+}
+
+// Several ranges go out as one in-memory multipart body, or not at all if it would be too big
+static bool add_multipart_ranges(http_response_t* response, int fd, size_t size, const byte_range_t* ranges,
+                                 int count, const char* path) {
+    char boundary[RANGE_BOUNDARY_SIZE];
+    char content_type[96];
+    format_range_boundary(boundary, sizeof(boundary));
+
+    multipart_job_t job = { fd, size, ranges, count, get_content_type(path), boundary, NULL, 0 };
+    run_blocking(run_multipart_job, &job);
+    if (!job.body || http_response_own(response, job.body) < 0) {
+        free(job.body);
+        return false;
+    }
+
+    snprintf(content_type, sizeof(content_type), "multipart/byteranges; boundary=%s", boundary);
+    http_response_add_body(response, job.body, job.length);
+    http_response_add_header(response, "Content-Type", content_type);
+    return true;
+}
+
+static void serve_static_asset(const http_request_t* request, const char* path, const char* headers,
+                               http_response_t* response) {
+    bool compressible = compression_enabled() && static_asset_compressible(path);
+    bool ranged = find_http_header(request, "Range") != NULL;
+    fd_cache_entry_t* file = NULL;
+    if (compressible && !ranged && serve_compressed_asset(request, path, headers, response, &file)) {
+        fd_cache_release(file);
+        return;
+    }
+
+    if (!file) {
+        file = open_static_asset(HTML_DIR, path);
+    }
+    if (!file) {
+        set_response(response, "404 Not Found", HTML_ERROR_HEADERS, "<h1>404 Not Found</h1>");
+        return;
+    }
+    size_t length = file->size;
+    time_t mtime = file->mtime;
+
+    char etag[ETAG_SIZE];
+    format_file_etag(etag, sizeof(etag), length, mtime);
+    bool fresh = check_validators(request, response, etag, mtime);
+    if (compressible) {
+        http_response_add_header(response, "Vary", "Accept-Encoding");
+    }
+    if (fresh) {
+        fd_cache_release(file);
+        set_response(response, "304 Not Modified", headers, NULL);
+        return;
+    }
+    http_response_add_header(response, "Accept-Ranges", "bytes");
+
+    byte_range_t ranges[RANGE_MAX_PARTS];
+    int count = 0;
+    char content_range[80];
+    range_result_t range = RANGE_NONE;
+    if (ranged && if_range_matches(request, etag, mtime)) {
+        range = parse_byte_ranges(request, length, ranges, &count);
+    }
+
+    if (range == RANGE_UNSATISFIABLE) {
+        fd_cache_release(file);
+        snprintf(content_range, sizeof(content_range), "bytes */%zu", length);
+        http_response_add_header(response, "Content-Range", content_range);
+        set_response(response, "416 Range Not Satisfiable", headers, NULL);
+        return;
+    }
+
+    if (range == RANGE_SATISFIABLE && count > 1 &&
+        add_multipart_ranges(response, file->fd, length, ranges, count, path)) {
+        fd_cache_release(file);
+        set_response(response, "206 Partial Content", NULL, NULL);
+        return;
+    }
+
+    size_t offset = 0;
+    const char* status = "200 OK";
+    if (range == RANGE_SATISFIABLE && count == 1) {
+        offset = ranges[0].start;
+        snprintf(content_range, sizeof(content_range), "bytes %zu-%zu/%zu",
+                 offset, offset + ranges[0].length - 1, length);
+        http_response_add_header(response, "Content-Range", content_range);
+        length = ranges[0].length;
+        status = "206 Partial Content";
+    }
+
+    // The response holds the entry, which keeps the descriptor open until sent
+    if (http_response_hold(response, file, release_open_file) < 0) {
+        fd_cache_release(file);
+        set_response(response, "500 Internal Server Error", HTML_ERROR_HEADERS, "<h1>500 Internal Server Error</h1>");
+        return;
+    }
+    if (http_response_add_file(response, file->fd, (off_t)offset, length) < 0) {
+        set_response(response, "500 Internal Server Error", HTML_ERROR_HEADERS, "<h1>500 Internal Server Error</h1>");
+        return;
+    }
+    set_response(response, status, headers, NULL);
+}
+#else
+// Compiled-in assets: body, variants and ETags all come from read-only data
+static void serve_embedded_asset(const http_request_t* request, const char* path, const char* headers,
+                                 http_response_t* response) {
+    char full_path[512];
+    const embedded_file_t* file = NULL;
+    if (static_asset_path(HTML_DIR, path, full_path, sizeof(full_path)) >= 0) {
+        file = find_embedded_file(full_path);
+    }
+    if (!file) {
+        set_response(response, "404 Not Found", HTML_ERROR_HEADERS, "<h1>404 Not Found</h1>");
+        return;
+    }
+
+    bool ranged = find_http_header(request, "Range") != NULL;
+    const char* data = (const char*)file->data;
+    size_t length = file->size;
+    const char* etag = file->etag;
+    const char* encoding = NULL;
+    for (int i = 0; compression_enabled() && !ranged && i < ENCODING_COUNT; i++) {
+        if (file->variants[i] && http_header_accepts(request, "Accept-Encoding", encoding_token(i))) {
+            data = (const char*)file->variants[i];
+            length = file->variant_sizes[i];
+            etag = file->variant_etags[i];
+            encoding = encoding_token(i);
+            break;
         }
-        file_path[sizeof(file_path) - 1] = '\0';
+    }
+
+    bool fresh = check_validators(request, response, etag, file->mtime);
+    if (static_asset_compressible(path)) {
+        http_response_add_header(response, "Vary", "Accept-Encoding");
+    }
+    if (fresh) {
+        set_response(response, "304 Not Modified", headers, NULL);
+        return;
+    }
+    if (encoding) {
+        http_response_add_header(response, "Content-Encoding", encoding);
     } else {
-        snprintf(file_path, sizeof(file_path), "%s/%s", HTML_DIR, html_file);
+        http_response_add_header(response, "Accept-Ranges", "bytes");
     }
-    
-    printf("%s%s[HTTP] %sServing HTML file: %s%s%s\n", 
-           BOLD, COLOR_GREEN, COLOR_RESET, COLOR_CYAN, file_path, COLOR_RESET);
-    
-    char* html_content = serve_html(file_path);
-    if (!html_content) {
-        const char* not_found_response = "HTTP/1.1 404 Not Found\r\nContent-Type: text/html\r\n\r\n<h1>404 Not Found</h1>";
-        write(new_socket, not_found_response, strlen(not_found_response));
-        close(new_socket);
+
+    byte_range_t ranges[RANGE_MAX_PARTS];
+    int count = 0;
+    char content_range[80];
+    range_result_t range = RANGE_NONE;
+    if (ranged && if_range_matches(request, etag, file->mtime)) {
+        range = parse_byte_ranges(request, length, ranges, &count);
+    }
+
+    if (range == RANGE_UNSATISFIABLE) {
+        snprintf(content_range, sizeof(content_range), "bytes */%zu", length);
+        http_response_add_header(response, "Content-Range", content_range);
+        set_response(response, "416 Range Not Satisfiable", headers, NULL);
         return;
     }
 
+    // Several ranges get the whole body, which a server is always free to send
+    const char* status = "200 OK";
+    if (range == RANGE_SATISFIABLE && count == 1) {
+        snprintf(content_range, sizeof(content_range), "bytes %zu-%zu/%zu",
+                 ranges[0].start, ranges[0].start + ranges[0].length - 1, length);
+        http_response_add_header(response, "Content-Range", content_range);
+        data += ranges[0].start;
+        length = ranges[0].length;
+        status = "206 Partial Content";
+    }
+
+    http_response_add_body(response, data, length);
+    set_response(response, status, headers, NULL);
+}
+#endif
+
+// Requests that would run a query are shed while SQLite is backed up
+static bool shed_for_database(http_response_t* response) {
+    if (!is_db_initialized() || admit_query()) {
+        return false;
+    }
+    http_response_add_header(response, "Retry-After", "1");
+    set_response(response, "503 Service Unavailable", HTML_ERROR_HEADERS, "<h1>503 Service Unavailable</h1>");
+    return true;
+}
+
+static bool form_result_pending(void) {
+    pthread_mutex_lock(&form_result_mutex);
+    bool pending = stored_form_result != NULL;
+    pthread_mutex_unlock(&form_result_mutex);
+    return pending;
+}
+
+static char* flatten_body(const http_response_t* response, size_t* length) {
+    char* body = malloc(response->body_length + 1);
+    if (!body) {
+        return NULL;
+    }
+
+    *length = 0;
+    for (int i = RESPONSE_HEAD_IOVS; i < response->iov_count; i++) {
+        memcpy(body + *length, response->iov[i].iov_base, response->iov[i].iov_len);
+        *length += response->iov[i].iov_len;
+    }
+    body[*length] = '\0';
+    return body;
+}
+
+// Template and SQL processing, the CPU-heavy part of a page, takes ownership of html_content
+static char* render_page(char* html_content, const char* html_file) {
     bool should_process_templates = enable_templates && has_template_features(html_content);
     char* processed_html = NULL;
 
     if (should_process_templates) {
-        printf("%s%s[TEMPLATE] %sProcessing template features in %s%s\n", 
-               BOLD, COLOR_MAGENTA, COLOR_RESET, html_file, COLOR_RESET);
+        REQUEST_LOG("%s%s[TEMPLATE] %sProcessing template features in %s%s\n", 
+                    BOLD, COLOR_MAGENTA, COLOR_RESET, html_file, COLOR_RESET);
         
         char port_str[10];
         snprintf(port_str, sizeof(port_str), "%d", server_port);
@@ -473,175 +656,340 @@ void handle_client(int new_socket) {
             "Dexter", "1", port_str, enable_templates ? "true" : "false"
         };
         
-        printf("%s%s[TEMPLATE] %sStarting template processing with %d variables%s\n", 
-               BOLD, COLOR_MAGENTA, COLOR_RESET, 4, COLOR_RESET);
+        REQUEST_LOG("%s%s[TEMPLATE] %sStarting template processing with %d variables%s\n", 
+                    BOLD, COLOR_MAGENTA, COLOR_RESET, 4, COLOR_RESET);
         
         processed_html = process_template_auto(html_content, keys, values, 4);
         if (processed_html) {
-            printf("%s%s[TEMPLATE] %sTemplate processing completed successfully%s\n", 
-                   BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
+            REQUEST_LOG("%s%s[TEMPLATE] %sTemplate processing completed successfully%s\n", 
+                        BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
             free(html_content);
             html_content = NULL;
             
             if (is_db_initialized()) {
-                printf("%s%s[SQLite] %sProcessing SQL queries in template%s\n", 
-                       BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
+                REQUEST_LOG("%s%s[SQLite] %sProcessing SQL queries in template%s\n", 
+                            BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
                        
                 char* sql_processed = process_sqlite_queries(processed_html);
                 if (sql_processed != processed_html) {
                     free(processed_html);
                     processed_html = sql_processed;
-                    printf("%s%s[SQLite] %sSQL query processing completed%s\n", 
-                           BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
+                    REQUEST_LOG("%s%s[SQLite] %sSQL query processing completed%s\n", 
+                                BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
                 }
             }
         } else {
-            printf("%s%s[TEMPLATE] %s%sTemplate processing failed, serving original content%s\n", 
-                   BOLD, COLOR_RED, BOLD, COLOR_RESET, COLOR_RESET);
+            REQUEST_LOG("%s%s[TEMPLATE] %s%sTemplate processing failed, serving original content%s\n", 
+                        BOLD, COLOR_RED, BOLD, COLOR_RESET, COLOR_RESET);
             processed_html = html_content;
             html_content = NULL;
             
             if (is_db_initialized()) {
-                printf("%s%s[SQLite] %sProcessing SQL queries%s\n", 
-                       BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
+                REQUEST_LOG("%s%s[SQLite] %sProcessing SQL queries%s\n", 
+                            BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
                        
                 char* sql_processed = process_sqlite_queries(processed_html);
                 if (sql_processed != processed_html) {
                     free(processed_html);
                     processed_html = sql_processed;
-                    printf("%s%s[SQLite] %sSQL query processing completed%s\n", 
-                           BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
+                    REQUEST_LOG("%s%s[SQLite] %sSQL query processing completed%s\n", 
+                                BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
                 }
             }
         }
     } else {
         if (!enable_templates) {
-            printf("%s%s[TEMPLATE] %sTemplate processing is disabled globally%s\n", 
-                  BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+            REQUEST_LOG("%s%s[TEMPLATE] %sTemplate processing is disabled globally%s\n", 
+                       BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
         } else {
-            printf("%s%s[TEMPLATE] %sNo template features found, serving without processing%s\n", 
-                  BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+            REQUEST_LOG("%s%s[TEMPLATE] %sNo template features found, serving without processing%s\n", 
+                       BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
         }
         processed_html = html_content;
         html_content = NULL;
         
         if (is_db_initialized()) {
-            printf("%s%s[SQLite] %sProcessing SQL queries%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
+            REQUEST_LOG("%s%s[SQLite] %sProcessing SQL queries%s\n", 
+                        BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
                    
             char* sql_processed = process_sqlite_queries(processed_html);
             if (sql_processed != processed_html) {
                 free(processed_html);
                 processed_html = sql_processed;
-                printf("%s%s[SQLite] %sSQL query processing completed%s\n", 
-                       BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
+                REQUEST_LOG("%s%s[SQLite] %sSQL query processing completed%s\n", 
+                            BOLD, COLOR_GREEN, COLOR_RESET, COLOR_RESET);
             }
         }
     }
 
-    static char* stored_form_result = NULL;
-    if (stored_form_result) {
-        char* inject_point = strstr(processed_html, "</body>");
-        if (inject_point) {
-            size_t prefix_len = inject_point - processed_html;
-            size_t suffix_len = strlen(inject_point);
-            size_t result_len = strlen(stored_form_result);
-            size_t new_len = prefix_len + result_len + suffix_len + 1;
+    return processed_html;
+}
+
+typedef struct {
+    char* html;
+    const char* html_file;
+    char* rendered;
+} render_job_t;
+
+static void run_render_job(void* arg) {
+    render_job_t* job = (render_job_t*)arg;
+    job->rendered = render_page(job->html, job->html_file);
+}
+
+static void route_request(const http_request_t* request, bool allow_keep_alive,
+                          http_response_t* response) {
+    init_http_response(response, allow_keep_alive && wants_keep_alive(request));
+    
+    char method[16];
+    char path[256];
+    
+    if (http_slice_copy(request->method, method, sizeof(method)) < 0) {
+        response->keep_alive = false;
+        set_response(response, "400 Bad Request", HTML_ERROR_HEADERS, "<h1>400 Bad Request</h1>");
+        return;
+    }
+    
+    if (http_slice_copy(request->path, path, sizeof(path)) < 0) {
+        set_response(response, "414 URI Too Long", HTML_ERROR_HEADERS, "<h1>414 URI Too Long</h1>");
+        return;
+    }
+    
+    REQUEST_LOG("%s%s[HTTP] %s%s request: %s%s\n", 
+                BOLD, COLOR_GREEN, COLOR_RESET, method, path, COLOR_RESET);
+    
+    const char* asset_headers = static_asset_headers(path);
+    if (asset_headers && (strcmp(method, "GET") == 0 || strcmp(method, "HEAD") == 0)) {
+#ifdef BLINK_EMBED_WWW
+        serve_embedded_asset(request, path, asset_headers, response);
+#else
+        serve_static_asset(request, path, asset_headers, response);
+#endif
+        return;
+    }
+    
+    bool is_sql_form = false;
+    char* form_result_html = NULL;
+    
+    if (strcmp(method, "POST") == 0 && strcmp(path, "/sql") == 0) {
+        if (shed_for_database(response)) {
+            return;
+        }
+        
+        REQUEST_LOG("%s%s[SQLite] %sReceived SQL form submission%s\n", 
+                    BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
+        
+        char* form_data = parse_form_data(request);
+        if (form_data) {
+            is_sql_form = true;
+            form_result_html = handle_sql_form(form_data);
+            free(form_data);
             
-            char* new_html = malloc(new_len);
-            if (new_html) {
-                memcpy(new_html, processed_html, prefix_len);
-                memcpy(new_html + prefix_len, stored_form_result, result_len);
-                memcpy(new_html + prefix_len + result_len, inject_point, suffix_len);
-                new_html[new_len - 1] = '\0';
-                
-                free(processed_html);
-                processed_html = new_html;
+            char referer[512] = "";
+            const http_slice_t* referer_header = find_http_header(request, "Referer");
+            if (referer_header) {
+                http_slice_copy(*referer_header, referer, sizeof(referer));
+            }
+            
+            char redirect_path[256] = "/";
+            const char* protocol_end = strstr(referer, "://");
+            if (protocol_end) {
+                const char* host_start = protocol_end + 3;
+                const char* path_start = strchr(host_start, '/');
+                if (path_start) {
+                    strncpy(redirect_path, path_start, sizeof(redirect_path) - 1);
+                    redirect_path[sizeof(redirect_path) - 1] = '\0';
+                }
             }
+            
+            pthread_mutex_lock(&form_result_mutex);
+            if (stored_form_result) {
+                free(stored_form_result);
+            }
+            stored_form_result = form_result_html;
+            pthread_mutex_unlock(&form_result_mutex);
+            
+            http_response_add_header(response, "Location", redirect_path);
+            set_response(response, "302 Found", NULL, NULL);
+            return;
         }
-        
-        free(stored_form_result);
-        stored_form_result = NULL;
     }
 
-    char* final_html = inject_hot_reload_js(processed_html);
-    if (!final_html) {
-        const char* error_response = "HTTP/1.1 500 Internal Server Error\r\nContent-Type: text/html\r\n\r\n"
-                                     "<h1>500 Internal Server Error</h1><p>Hot reload script injection failed</p>";
-        write(new_socket, error_response, strlen(error_response));
-        close(new_socket);
-        return;
+    char html_file[256] = "index.html";
+    char file_path[512];
+    
+    if (custom_html_file) {
+        if (html_file_exists(custom_html_file)) {
+            char* filename = strrchr(custom_html_file, '/');
+            if (filename) {
+                filename++; 
+                strncpy(html_file, filename, sizeof(html_file) - 1);
+            } else {
+                strncpy(html_file, custom_html_file, sizeof(html_file) - 1);
+            }
+            
+            REQUEST_LOG("%s%s[HTTP] %sUsing custom HTML file: %s%s%s\n", 
+                        BOLD, COLOR_GREEN, COLOR_RESET, COLOR_CYAN, html_file, COLOR_RESET);
+        } else {
+            REQUEST_LOG("%s%s[HTTP] %s%sCustom HTML file not found: %s, falling back to index.html%s\n", 
+                        BOLD, COLOR_RED, BOLD, COLOR_RESET, custom_html_file, COLOR_RESET);
+        }
+        strncpy(file_path, custom_html_file, sizeof(file_path) - 1);
+        file_path[sizeof(file_path) - 1] = '\0';
+    } else if (resolve_route(path, strlen(path), file_path, sizeof(file_path))) {
+        snprintf(html_file, sizeof(html_file), "%s", strrchr(file_path, '/') + 1);
+    } else {
+        // Paths without a page get the index, as they always have
+        snprintf(file_path, sizeof(file_path), "%s/%s", HTML_DIR, html_file);
     }
-
-    const char* headers = "HTTP/1.1 200 OK\r\n"
-                         "Content-Type: text/html; charset=UTF-8\r\n"
-                         "Connection: keep-alive\r\n"
-                         "Cache-Control: no-store, no-cache, must-revalidate, max-age=0\r\n"
-                         "Pragma: no-cache\r\n"
-                         "Access-Control-Allow-Origin: *\r\n"
-                         "\r\n";
     
-    write(new_socket, headers, strlen(headers));
-    write(new_socket, final_html, strlen(final_html));
-    free(final_html);
-    final_html = NULL;
-    close(new_socket);
-}
+    REQUEST_LOG("%s%s[HTTP] %sServing HTML file: %s%s%s\n", 
+                BOLD, COLOR_GREEN, COLOR_RESET, COLOR_CYAN, file_path, COLOR_RESET);
+    
+    file_cache_entry_t* page = load_cached_file(file_path);
+    if (page && !page->missing && !form_result_pending() &&
+        serve_cached_body(request, page, false, page_headers(), response)) {
+        return;
+    }
+    // Pages without queries render the same every time
+    bool queries = page && page->data && strstr(page->data, "{% query");
+    bool cacheable = page && page->data && !queries;
+    if (queries && shed_for_database(response)) {
+        file_cache_release(page);
+        return;
+    }
 
-void handle_websocket_client(int new_socket, ws_clients_t* clients) {
-    if (!clients || new_socket <= 0) {
-        if (new_socket > 0) close(new_socket);
+    char* html_content = serve_html(file_path);
+    if (!html_content) {
+        file_cache_release(page);
+        set_response(response, "404 Not Found", HTML_ERROR_HEADERS, "<h1>404 Not Found</h1>");
         return;
     }
 
-    char buffer[BUFFER_SIZE] = { 0 };
-    
-    struct timeval tv;
-    tv.tv_sec = 2;
-    tv.tv_usec = 0;
-    if (setsockopt(new_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv) < 0) {
-        perror("setsockopt failed");
-        close(new_socket);
+    render_job_t job = { html_content, html_file, NULL };
+    if (!run_blocking(run_render_job, &job)) {
+        free(html_content);
+        file_cache_release(page);
+        set_response(response, "503 Service Unavailable", HTML_ERROR_HEADERS, "<h1>503 Service Unavailable</h1>");
         return;
     }
-    
-    ssize_t bytes_read = read(new_socket, buffer, BUFFER_SIZE - 1);
-    if (bytes_read <= 0) {
-        perror("Error reading WebSocket handshake request");
-        close(new_socket);
+    char* processed_html = job.rendered;
+
+    pthread_mutex_lock(&form_result_mutex);
+    char* form_result = stored_form_result;
+    stored_form_result = NULL;
+    pthread_mutex_unlock(&form_result_mutex);
+
+    http_response_own(response, processed_html);
+    bool has_form_result = form_result != NULL;
+    const char* inject_point = has_form_result || !PRODUCTION_MODE ? strstr(processed_html, "</body>") : NULL;
+    if (inject_point) {
+        http_response_add_body(response, processed_html, inject_point - processed_html);
+        if (form_result) {
+            http_response_own(response, form_result);
+            http_response_add_body(response, form_result, strlen(form_result));
+        }
+        if (!PRODUCTION_MODE) {
+            size_t script_len;
+            const char* script = get_hot_reload_js(&script_len);
+            http_response_add_body(response, script, script_len);
+        }
+        http_response_add_body(response, inject_point, strlen(inject_point));
+    } else {
+        if (has_form_result || !PRODUCTION_MODE) {
+            REQUEST_LOG("No </body> tag found in HTML content, not injecting hot reload script\n");
+        }
+        free(form_result);
+        http_response_add_body(response, processed_html, strlen(processed_html));
+    }
+
+    // The full body is kept with its source entry so later requests skip rendering
+    bool keep = cacheable && !has_form_result;
+    size_t length = 0;
+    char* body = keep || http_cache_enabled() ? flatten_body(response, &length) : NULL;
+    char etag[ETAG_SIZE] = "";
+    if (body && http_cache_enabled()) {
+        format_etag(etag, sizeof(etag), xxh64(body, length, 0), NULL);
+    }
+    if (body && keep && file_cache_attach_rendered(page, body, length)) {
+        schedule_compression(page);
+        body = NULL;
+    }
+    free(body);
+
+    time_t mtime = cacheable ? page->mtime : 0;
+    file_cache_release(page);
+
+    bool fresh = etag[0] && check_validators(request, response, etag, mtime);
+    http_response_add_header(response, "Vary", "Accept-Encoding");
+    set_response(response, fresh ? "304 Not Modified" : "200 OK", page_headers(), NULL);
+}
+
+void build_http_response(const http_request_t* request, bool allow_keep_alive,
+                         http_response_t* response) {
+    route_request(request, allow_keep_alive, response);
+    // HEAD is answered like GET, minus the body
+    if (http_slice_equals(request->method, "HEAD")) {
+        http_response_drop_body(response);
+    }
+}
+
+void set_stats_endpoint(bool enabled) {
+    stats_enabled = enabled;
+}
+
+// Off unless --stats: behind a local reverse proxy every client looks like a local peer
+bool is_stats_request(const http_request_t* request) {
+    return stats_enabled && http_slice_equals(request->method, "GET") && http_slice_equals(request->path, STATS_PATH);
+}
+
+void build_stats_response(bool allow_keep_alive, http_response_t* response) {
+    init_http_response(response, allow_keep_alive);
+
+    char* body = malloc(1024);
+    int length = body ? format_admission_stats(body, 1024) : -1;
+    int more = length >= 0 ? format_rate_limit_stats(body + length, 1024 - length) : -1;
+    length = more >= 0 ? length + more : -1;
+    more = length >= 0 ? format_file_cache_stats(body + length, 1024 - length) : -1;
+    length = more >= 0 ? length + more : -1;
+    more = length >= 0 ? format_fd_cache_stats(body + length, 1024 - length) : -1;
+    length = more >= 0 ? length + more : -1;
+    if (length < 0 || http_response_own(response, body) < 0) {
+        free(body);
+        set_response(response, "500 Internal Server Error", HTML_ERROR_HEADERS, "<h1>500 Internal Server Error</h1>");
         return;
     }
-    
-    buffer[bytes_read] = '\0';
-    char* origin = strstr(buffer, "Origin: ");
+
+    set_response(response, "200 OK", STATS_HEADERS, body);
+}
+
+int handle_websocket_upgrade(int new_socket, const http_request_t* request, ws_clients_t* clients) {
+    if (!clients || new_socket <= 0 || !request) {
+        return -1;
+    }
+
+    const http_slice_t* origin = find_http_header(request, "Origin");
     if (origin) {
-        char* end = strstr(origin, "\r\n");
-        if (end) {
-            *end = '\0';
-            printf("%s%s[WebSocket] %sConnection attempt from %s%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_RESET, origin + 8, COLOR_RESET);
-            *end = '\r'; 
-        }
+        REQUEST_LOG("%s%s[WebSocket] %sConnection attempt from %.*s%s\n", 
+                    BOLD, COLOR_BLUE, COLOR_RESET, (int)origin->len, origin->data, COLOR_RESET);
     }
     
-    if (is_websocket_request(buffer)) {
-        printf("%s%s[WebSocket] %sHandshake received%s\n", 
-               BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
-        if (process_ws_handshake(new_socket, buffer) == 0) {
-            printf("%s%s[WebSocket] %s%sHandshake successful%s\n", 
-                   BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET);
-            add_ws_client(clients, new_socket);
-            return;
+    if (is_websocket_request(request)) {
+        REQUEST_LOG("%s%s[WebSocket] %sHandshake received%s\n", 
+                    BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
+        if (process_ws_handshake(new_socket, request) == 0) {
+            REQUEST_LOG("%s%s[WebSocket] %s%sHandshake successful%s\n", 
+                        BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET);
+            return add_ws_client(clients, new_socket);
         } else {
-            printf("%s%s[WebSocket] %s%sHandshake failed%s\n", 
-                   BOLD, COLOR_BLUE, BOLD, COLOR_RED, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %s%sHandshake failed%s\n", 
+                        BOLD, COLOR_BLUE, BOLD, COLOR_RED, COLOR_RESET);
         }
     } else {
-        printf("%s%s[WebSocket] %s%sNot a valid WebSocket upgrade request%s\n", 
-               BOLD, COLOR_BLUE, BOLD, COLOR_RED, COLOR_RESET);
+        REQUEST_LOG("%s%s[WebSocket] %s%sNot a valid WebSocket upgrade request%s\n", 
+                    BOLD, COLOR_BLUE, BOLD, COLOR_RED, COLOR_RESET);
     }
     
-    close(new_socket);
+    return -1;
 }
 
 void set_template_settings(bool enabled) {
@@ -0,0 +1,244 @@
+#include "route_table.h"
+#include "websocket.h"
+#ifdef BLINK_EMBED_WWW
+#include "embedded_files.h"
+#endif
+#include <dirent.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+static route_entry_t* buckets[ROUTE_BUCKETS];
+static pthread_rwlock_t route_lock = PTHREAD_RWLOCK_INITIALIZER;
+static char* route_root = NULL;
+static int route_count = 0;
+
+static uint64_t hash_url(const char* url, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < len; i++) {
+        hash = (hash ^ (unsigned char)url[i]) * 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static bool is_page(const char* name) {
+    const char* dot = strrchr(name, '.');
+    return dot && strcmp(dot, ".html") == 0;
+}
+
+// Caller holds the write lock
+static void put_route(const char* url, size_t url_len, const char* file) {
+    uint64_t hash = hash_url(url, url_len);
+    route_entry_t** link = &buckets[hash % ROUTE_BUCKETS];
+    for (route_entry_t* entry = *link; entry; entry = entry->next) {
+        if (entry->hash == hash && strlen(entry->url) == url_len && memcmp(entry->url, url, url_len) == 0) {
+            return;
+        }
+    }
+
+    route_entry_t* entry = calloc(1, sizeof(route_entry_t));
+    if (!entry || !(entry->url = strndup(url, url_len)) || !(entry->file = strdup(file))) {
+        if (entry) {
+            free(entry->url);
+        }
+        free(entry);
+        return;
+    }
+    entry->hash = hash;
+    entry->next = *link;
+    *link = entry;
+    route_count++;
+}
+
+// Caller holds the write lock; drops every route whose file matches, or lies under a directory prefix
+static void drop_routes(const char* file, bool prefix) {
+    size_t file_len = strlen(file);
+    for (int i = 0; i < ROUTE_BUCKETS; i++) {
+        route_entry_t** link = &buckets[i];
+        while (*link) {
+            route_entry_t* entry = *link;
+            bool match = prefix ? strncmp(entry->file, file, file_len) == 0 && entry->file[file_len] == '/'
+                                : strcmp(entry->file, file) == 0;
+            if (match) {
+                *link = entry->next;
+                free(entry->url);
+                free(entry->file);
+                free(entry);
+                route_count--;
+            } else {
+                link = &entry->next;
+            }
+        }
+    }
+}
+
+// Caller holds the write lock
+static void add_page_routes(const char* file) {
+    size_t root_len = strlen(route_root);
+    if (strncmp(file, route_root, root_len) != 0 || file[root_len] != '/' || !is_page(file)) {
+        return;
+    }
+
+    const char* url = file + root_len;
+    size_t url_len = strlen(url);
+    size_t stem_len = url_len - strlen(".html");
+    put_route(url, url_len, file);
+    put_route(url, stem_len, file);
+
+    const char* slash = strrchr(url, '/');
+    if (strcmp(slash, "/index.html") == 0) {
+        size_t dir_len = (size_t)(slash - url);
+        put_route(url, dir_len + 1, file);
+        if (dir_len > 0) {
+            put_route(url, dir_len, file);
+        }
+    }
+}
+
+// Caller holds the write lock
+static void scan_pages(const char* directory, int depth) {
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        char path[512];
+        int written = snprintf(path, sizeof(path), "%s/%s", directory, entry->d_name);
+        if (written < 0 || (size_t)written >= sizeof(path)) {
+            continue;
+        }
+
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode) && depth < ROUTE_MAX_DEPTH) {
+            scan_pages(path, depth + 1);
+        } else if (S_ISREG(st.st_mode) && is_page(entry->d_name)) {
+            add_page_routes(path);
+        }
+    }
+    closedir(dir);
+}
+
+#ifdef BLINK_EMBED_WWW
+// Caller holds the write lock; embedded pages stand in for the directory scan
+static void scan_root(void) {
+    for (size_t i = 0; i < embedded_file_count(); i++) {
+        char path[512];
+        int written = snprintf(path, sizeof(path), "%s%s", route_root, embedded_file_at(i)->path);
+        if (written > 0 && (size_t)written < sizeof(path)) {
+            add_page_routes(path);
+        }
+    }
+}
+#else
+static void scan_root(void) {
+    scan_pages(route_root, 0);
+}
+#endif
+
+static void clear_routes(void) {
+    for (int i = 0; i < ROUTE_BUCKETS; i++) {
+        while (buckets[i]) {
+            route_entry_t* entry = buckets[i];
+            buckets[i] = entry->next;
+            free(entry->url);
+            free(entry->file);
+            free(entry);
+        }
+    }
+    route_count = 0;
+}
+
+int init_route_table(const char* root) {
+    route_root = strdup(root);
+    if (!route_root) {
+        return -1;
+    }
+
+    pthread_rwlock_wrlock(&route_lock);
+    scan_root();
+    pthread_rwlock_unlock(&route_lock);
+
+    printf("%s%s[ROUTES] %sMapped %s%d%s URL paths under %s%s%s\n",
+           BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, route_count, COLOR_GREEN, COLOR_CYAN, root, COLOR_RESET);
+    return 0;
+}
+
+bool resolve_route(const char* url, size_t url_len, char* file, size_t file_size) {
+    uint64_t hash = hash_url(url, url_len);
+    bool found = false;
+
+    pthread_rwlock_rdlock(&route_lock);
+    for (route_entry_t* entry = buckets[hash % ROUTE_BUCKETS]; entry; entry = entry->next) {
+        if (entry->hash == hash && strlen(entry->url) == url_len && memcmp(entry->url, url, url_len) == 0) {
+            found = (size_t)snprintf(file, file_size, "%s", entry->file) < file_size;
+            break;
+        }
+    }
+    pthread_rwlock_unlock(&route_lock);
+    return found;
+}
+
+void route_file_added(const char* file) {
+    if (!route_root) {
+        return;
+    }
+    pthread_rwlock_wrlock(&route_lock);
+    add_page_routes(file);
+    pthread_rwlock_unlock(&route_lock);
+}
+
+void route_file_removed(const char* file) {
+    if (!route_root) {
+        return;
+    }
+    pthread_rwlock_wrlock(&route_lock);
+    drop_routes(file, false);
+    pthread_rwlock_unlock(&route_lock);
+}
+
+void route_directory_added(const char* directory) {
+    if (!route_root) {
+        return;
+    }
+    pthread_rwlock_wrlock(&route_lock);
+    scan_pages(directory, 1);
+    pthread_rwlock_unlock(&route_lock);
+}
+
+void route_directory_removed(const char* directory) {
+    if (!route_root) {
+        return;
+    }
+    pthread_rwlock_wrlock(&route_lock);
+    drop_routes(directory, true);
+    pthread_rwlock_unlock(&route_lock);
+}
+
+void rebuild_route_table(void) {
+    if (!route_root) {
+        return;
+    }
+    pthread_rwlock_wrlock(&route_lock);
+    clear_routes();
+    scan_root();
+    pthread_rwlock_unlock(&route_lock);
+}
+
+void free_route_table(void) {
+    pthread_rwlock_wrlock(&route_lock);
+    clear_routes();
+    free(route_root);
+    route_root = NULL;
+    pthread_rwlock_unlock(&route_lock);
+}
@@ -2,27 +2,39 @@
 #include <signal.h>
 #include <errno.h>
 #include <sys/signal.h>
+#include <sys/wait.h>
 #include "sqlite_handler.h"
 #include "debug.h"
+#include "event_loop.h"
+#include "shard.h"
+#include "upgrade.h"
+#include "admission.h"
+#include "rate_limit.h"
+#include "placement.h"
+#include "file_cache.h"
+#include "fd_cache.h"
+#include "minify.h"
+#ifdef BLINK_EMBED_WWW
+#include "embedded_files.h"
+#endif
+#include "compression.h"
+#include "http_cache.h"
+#include "route_table.h"
 
 #define PORT 8080
 #define BUFFER_SIZE 1024
-#define RELOAD_DELAY_MS 300
 #define SHUTDOWN_TIMEOUT_SEC 5 
 
-typedef struct {
-    ws_clients_t* clients;
-    bool* file_changed;
-    pthread_mutex_t* mutex;
-} ws_monitor_args_t;
-
 volatile sig_atomic_t server_running = 1;
 volatile sig_atomic_t shutdown_in_progress = 0;
-pthread_t watcher_thread = 0;
-pthread_t monitor_thread = 0;
+volatile sig_atomic_t server_draining = 0;
+int watch_fd = -1;
+#ifndef BLINK_PRODUCTION
+bool production_mode = false;
+#endif
 ws_clients_t* ws_clients = NULL;
-pthread_mutex_t* file_mutex_ptr = NULL;
-ws_monitor_args_t* monitor_args = NULL;
+shard_set_t* shard_set = NULL;
+worker_pool_t* worker_pool = NULL;
 
 void cleanup_resources(void);
 
@@ -49,86 +61,48 @@ void signal_handler(int signum) {
     sigaction(SIGTERM, &forced_exit, NULL);
 }
 
-void* shutdown_watchdog(void* arg) {
-    int timeout = SHUTDOWN_TIMEOUT_SEC;
-    printf("%s%s[SERVER] %sShutdown watchdog started (timeout: %d seconds)%s\n", 
-           BOLD, COLOR_BLUE, COLOR_CYAN, timeout, COLOR_RESET);
-    
-    sleep(timeout);
+void drain_handler(int signum) {
+    (void)signum;
+    if (server_draining) {
+        return;
+    }
+
+    server_draining = 1;
+    printf("\n%s%s[SERVER] %sReceived SIGQUIT. Draining connections before exit...%s\n",
+           BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_RESET);
+}
+
+void upgrade_handler(int signum) {
+    static pid_t upgrade_pid = 0;
+    (void)signum;
+
+    if (server_draining || shutdown_in_progress) {
+        return;
+    }
+    if (upgrade_pid > 0 && waitpid(upgrade_pid, NULL, WNOHANG) == 0) {
+        printf("%s%s[UPGRADE] %sUpgrade already in progress (pid %d)%s\n",
+               BOLD, COLOR_YELLOW, COLOR_RESET, (int)upgrade_pid, COLOR_RESET);
+        return;
+    }
+
+    upgrade_pid = spawn_upgrade();
+    if (upgrade_pid < 0) {
+        printf("%s%s[UPGRADE] %sFailed to start new server process%s\n",
+               BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+        upgrade_pid = 0;
+        return;
+    }
+    printf("\n%s%s[UPGRADE] %sStarted new server process %s%d%s, keeping listeners open%s\n",
+           BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, (int)upgrade_pid, COLOR_GREEN, COLOR_RESET);
+}
+
+void shutdown_watchdog(int signum) {
+    (void)signum;
     if (shutdown_in_progress) {
         printf("%s%s[SERVER] %s%sShutdown timeout exceeded! Forcing exit...%s\n", 
                BOLD, COLOR_RED, BOLD, COLOR_YELLOW, COLOR_RESET);
         _exit(EXIT_FAILURE);
     }
-    
-    return NULL;
-}
-
-void* ws_monitor_thread(void* args) {
-    ws_monitor_args_t* monitor_args = (ws_monitor_args_t*)args;
-    bool last_change_state = false;
-    time_t last_reload_time = 0;
-    const int RELOAD_COOLDOWN_SEC = 1; 
-    const int PING_INTERVAL_MS = 10000; 
-    time_t last_ping_time = 0;
-    
-    printf("%s%s[WS MONITOR] %sThread started%s\n", 
-           BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_RESET);
-    
-    while (server_running) {
-        time_t current_time = time(NULL);
-        bool should_notify = false;
-        if (difftime(current_time, last_ping_time) * 1000 >= PING_INTERVAL_MS) {
-            if (monitor_args->clients && monitor_args->clients->count > 0) {
-                broadcast_to_ws_clients(monitor_args->clients, "ping");
-                last_ping_time = current_time;
-            }
-        }
-        
-        pthread_mutex_lock(monitor_args->mutex);
-        bool current_change_state = *(monitor_args->file_changed);
-        
-        if (current_change_state) {
-            if (difftime(current_time, last_reload_time) >= RELOAD_COOLDOWN_SEC) {
-                printf("%s%s[HOT RELOAD] %sFile changes detected, preparing notification%s\n", 
-                       BOLD, COLOR_MAGENTA, COLOR_RESET, COLOR_RESET);
-                
-                if (monitor_args->clients && monitor_args->clients->count > 0) {
-                    should_notify = true;
-                    last_reload_time = current_time;
-                } else {
-                    printf("%s%s[HOT RELOAD] %sNo clients connected, skipping notification%s\n", 
-                           BOLD, COLOR_MAGENTA, COLOR_YELLOW, COLOR_RESET);
-                }
-                
-                *(monitor_args->file_changed) = false;
-            } else {
-                printf("%s%s[HOT RELOAD] %sChanges detected during cooldown period (%ds), deferring%s\n", 
-                       BOLD, COLOR_MAGENTA, COLOR_YELLOW, RELOAD_COOLDOWN_SEC, COLOR_RESET);
-            }
-        }
-        
-        pthread_mutex_unlock(monitor_args->mutex);
-        
-        if (should_notify) {
-            usleep(RELOAD_DELAY_MS * 1000);
-            printf("%s%s[HOT RELOAD] %sNotifying %s%d%s client(s) to reload%s\n", 
-                   BOLD, COLOR_MAGENTA, COLOR_RESET, 
-                   COLOR_YELLOW, monitor_args->clients->count, COLOR_RESET, COLOR_RESET);
-            
-            broadcast_to_ws_clients(monitor_args->clients, "reload");
-            
-            printf("%s%s[HOT RELOAD] %s%sReload notification sent successfully%s\n", 
-                   BOLD, COLOR_MAGENTA, BOLD, COLOR_GREEN, COLOR_RESET);
-        }
-        
-        last_change_state = current_change_state;
-        usleep(100000);
-    }
-    
-    printf("%s%s[WS MONITOR] %s%sThread stopped%s\n", 
-           BOLD, COLOR_BLUE, BOLD, COLOR_YELLOW, COLOR_RESET);
-    return NULL;
 }
 
 void cleanup_resources(void) {
@@ -140,19 +114,33 @@ void cleanup_resources(void) {
     cleanup_running = 1;
     printf("%s%s[SERVER] %sShutdown in progress, cleaning up resources...%s\n", 
            BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
-    pthread_t watchdog_thread;
-    if (!pthread_create(&watchdog_thread, NULL, shutdown_watchdog, NULL)) {
-        pthread_detach(watchdog_thread);
-    }
+    printf("%s%s[SERVER] %sShutdown watchdog armed (timeout: %d seconds)%s\n", 
+           BOLD, COLOR_BLUE, COLOR_CYAN, SHUTDOWN_TIMEOUT_SEC, COLOR_RESET);
+    signal(SIGALRM, shutdown_watchdog);
+    alarm(SHUTDOWN_TIMEOUT_SEC);
     
     server_running = 0;
 
+    if (worker_pool) {
+        printf("%s%s[SERVER] %sStopping worker threads...%s\n", 
+              BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
+        free_worker_pool(worker_pool);
+        worker_pool = NULL;
+    }
+    
     if (is_db_initialized()) {
         printf("%s%s[SERVER] %sClosing SQLite database connection...%s\n", 
               BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
         close_sqlite();
     }
     
+    if (shard_set) {
+        printf("%s%s[SERVER] %sClosing listeners and client connections...%s\n", 
+              BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
+        free_shards(shard_set);
+        shard_set = NULL;
+    }
+    
     if (ws_clients) {
         printf("%s%s[SERVER] %sClosing WebSocket connections...%s\n", 
               BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
@@ -160,70 +148,43 @@ void cleanup_resources(void) {
         ws_clients = NULL;
     }
     
-    if (watcher_thread != 0) {
-        printf("%s%s[SERVER] %sStopping file watcher thread...%s\n", 
+    if (watch_fd >= 0) {
+        printf("%s%s[SERVER] %sStopping file watcher...%s\n", 
               BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
-        int cancel_result = pthread_cancel(watcher_thread);
-        if (cancel_result != 0) {
-            fprintf(stderr, "%s%s[ERROR] %sFailed to cancel file watcher thread (error %d)%s\n", 
-                    BOLD, COLOR_RED, COLOR_RESET, cancel_result, COLOR_RESET);
-        }
-        int join_result = pthread_join(watcher_thread, NULL);
-        if (join_result != 0) {
-            fprintf(stderr, "%s%s[ERROR] %sFailed to join file watcher thread (error %d)%s\n", 
-                    BOLD, COLOR_RED, COLOR_RESET, join_result, COLOR_RESET);
-            pthread_detach(watcher_thread);
-        } else {
-            printf("%s%s[SERVER] %sFile watcher thread stopped%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_RESET);
-        }
-        watcher_thread = 0;
-    }
-    
-    if (monitor_thread != 0) {
-        printf("%s%s[SERVER] %sStopping WebSocket monitor thread...%s\n", 
-              BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_RESET);
-        int cancel_result = pthread_cancel(monitor_thread);
-        if (cancel_result != 0) {
-            fprintf(stderr, "%s%s[ERROR] %sFailed to cancel WebSocket monitor thread (error %d)%s\n", 
-                    BOLD, COLOR_RED, COLOR_RESET, cancel_result, COLOR_RESET);
-        }
-        int join_result = pthread_join(monitor_thread, NULL);
-        if (join_result != 0) {
-            fprintf(stderr, "%s%s[ERROR] %sFailed to join WebSocket monitor thread (error %d)%s\n", 
-                    BOLD, COLOR_RED, COLOR_RESET, join_result, COLOR_RESET);
-            pthread_detach(monitor_thread);
-        } else {
-            printf("%s%s[SERVER] %sWebSocket monitor thread stopped%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_RESET);
-        }
-        monitor_thread = 0;
-    }
-    
-    if (monitor_args) {
-        free(monitor_args);
-        monitor_args = NULL;
-    }
-    
-    if (file_mutex_ptr) {
-        pthread_mutex_destroy(file_mutex_ptr);
-        file_mutex_ptr = NULL;
+        close_file_watcher(watch_fd);
+        watch_fd = -1;
     }
     
+    free_upgrade();
+    free_compression();
+    free_route_table();
+    free_file_cache();
+    free_fd_cache();
+
     printf("%s%s[SERVER] %s%sCleanup complete%s\n", 
            BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET);
+    alarm(0);
     cleanup_running = 0;
     shutdown_in_progress = 0;
 }
 
 int main(int argc, char *argv[]) {
-    int server_fd = -1, new_socket;
-    struct sockaddr_in address;
-    int addrlen = sizeof(address);
-    bool file_changed = false;
-    pthread_mutex_t file_mutex = PTHREAD_MUTEX_INITIALIZER;
-    file_mutex_ptr = &file_mutex;
     int port = PORT; 
+    long online_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int workers = online_cpus > 0 ? (int)online_cpus : 1;
+    int shards = 1;
+    bool use_cbpf = false;
+    bool use_tcp = true;
+    char* unix_path = NULL;
+    int unix_fd = -1;
+    int backlog = SOMAXCONN;
+    int defer_accept_sec = DEFER_ACCEPT_SEC;
+    int file_cache_mb = FILE_CACHE_BUDGET_MB;
+    int fd_cache_entries = FD_CACHE_MAX_ENTRIES;
+    bool compress = true;
+    int max_inflight = ADMISSION_MAX_INFLIGHT;
+    int max_queue_wait_ms = ADMISSION_MAX_QUEUE_WAIT_MS;
+    int max_db_busy_ms = ADMISSION_MAX_DB_BUSY_MS;
     char* custom_html_file = NULL;
     char* db_path = NULL;
     
@@ -251,6 +212,120 @@ int main(int argc, char *argv[]) {
                             BOLD, COLOR_YELLOW, COLOR_RESET, PORT, COLOR_RESET);
                 }
             }
+        } else if (strcmp(argv[i], "-w") == 0 || strcmp(argv[i], "--workers") == 0) {
+            if (i + 1 < argc) {
+                int custom_workers = atoi(argv[i + 1]);
+                if (custom_workers >= 0 && custom_workers <= MAX_WORKERS) {
+                    workers = custom_workers;
+                    i++;
+                } else {
+                    fprintf(stderr, "%s%s[CONFIG] %sInvalid worker count (0-%d). Using %d%s\n", 
+                            BOLD, COLOR_YELLOW, COLOR_RESET, MAX_WORKERS, workers, COLOR_RESET);
+                }
+            }
+        } else if (strcmp(argv[i], "-S") == 0 || strcmp(argv[i], "--shards") == 0) {
+            if (i + 1 < argc) {
+                int custom_shards = atoi(argv[i + 1]);
+                if (custom_shards > 0 && custom_shards <= MAX_SHARDS) {
+                    shards = custom_shards;
+                    i++;
+                } else {
+                    fprintf(stderr, "%s%s[CONFIG] %sInvalid shard count (1-%d). Using %d%s\n", 
+                            BOLD, COLOR_YELLOW, COLOR_RESET, MAX_SHARDS, shards, COLOR_RESET);
+                }
+            }
+        } else if (strcmp(argv[i], "--cbpf") == 0) {
+            use_cbpf = true;
+        } else if (strcmp(argv[i], "--unix") == 0) {
+            if (i + 1 < argc) {
+                unix_path = argv[i + 1];
+                i++;
+            } else {
+                fprintf(stderr, "%s%s[CONFIG] %sNo path specified after --unix option%s\n", 
+                        BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+            }
+        } else if (strcmp(argv[i], "--no-tcp") == 0) {
+            use_tcp = false;
+        } else if (strcmp(argv[i], "--file-cache") == 0) {
+            if (i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+                file_cache_mb = atoi(argv[i + 1]);
+                i++;
+            } else {
+                fprintf(stderr, "%s%s[CONFIG] %sInvalid value for --file-cache, keeping default%s\n", 
+                        BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+            }
+        } else if (strcmp(argv[i], "--fd-cache") == 0) {
+            if (i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+                fd_cache_entries = atoi(argv[i + 1]);
+                i++;
+            } else {
+                fprintf(stderr, "%s%s[CONFIG] %sInvalid value for --fd-cache, keeping default%s\n", 
+                        BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+            }
+        } else if (strcmp(argv[i], "--no-compress") == 0) {
+            compress = false;
+        } else if (strcmp(argv[i], "--minify") == 0) {
+            configure_minify(true);
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            set_stats_endpoint(true);
+        } else if (strcmp(argv[i], "--cache") == 0) {
+            configure_http_cache(true);
+        } else if (strcmp(argv[i], "--production") == 0) {
+#ifndef BLINK_PRODUCTION
+            production_mode = true;
+#endif
+        } else if (strcmp(argv[i], "--backlog") == 0 || strcmp(argv[i], "--defer-accept") == 0) {
+            if (i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+                if (strcmp(argv[i], "--backlog") == 0) {
+                    backlog = atoi(argv[i + 1]);
+                } else {
+                    defer_accept_sec = atoi(argv[i + 1]);
+                }
+                i++;
+            } else {
+                fprintf(stderr, "%s%s[CONFIG] %sInvalid value for %s, keeping default%s\n", 
+                        BOLD, COLOR_YELLOW, COLOR_RESET, argv[i], COLOR_RESET);
+            }
+        } else if (strcmp(argv[i], "--rate-limit") == 0 || strcmp(argv[i], "--ws-rate-limit") == 0) {
+            int rate = 0;
+            int burst = 0;
+            if (i + 1 < argc && sscanf(argv[i + 1], "%d:%d", &rate, &burst) >= 1 && rate >= 0 && burst >= 0) {
+                configure_rate_limit(strcmp(argv[i], "--rate-limit") == 0 ? RATE_LIMIT_HTTP : RATE_LIMIT_WEBSOCKET,
+                                     rate, burst);
+                i++;
+            } else {
+                fprintf(stderr, "%s%s[CONFIG] %sExpected RATE[:BURST] after %s%s\n", 
+                        BOLD, COLOR_YELLOW, COLOR_RESET, argv[i], COLOR_RESET);
+            }
+        } else if (strcmp(argv[i], "--loop-cpus") == 0 ||
+                   strcmp(argv[i], "--worker-cpus") == 0 ||
+                   strcmp(argv[i], "--housekeeping-cpus") == 0) {
+            placement_role_t role = strcmp(argv[i], "--loop-cpus") == 0 ? PLACEMENT_LOOP
+                                  : strcmp(argv[i], "--worker-cpus") == 0 ? PLACEMENT_WORKER
+                                  : PLACEMENT_HOUSEKEEPING;
+            if (i + 1 < argc && configure_placement(role, argv[i + 1]) == 0) {
+                i++;
+            } else {
+                fprintf(stderr, "%s%s[CONFIG] %sExpected a CPU list such as 0-3,8 after %s%s\n", 
+                        BOLD, COLOR_YELLOW, COLOR_RESET, argv[i], COLOR_RESET);
+            }
+        } else if (strcmp(argv[i], "--max-inflight") == 0 ||
+                   strcmp(argv[i], "--max-queue-wait") == 0 ||
+                   strcmp(argv[i], "--max-db-busy") == 0) {
+            if (i + 1 < argc && atoi(argv[i + 1]) >= 0) {
+                int limit = atoi(argv[i + 1]);
+                if (strcmp(argv[i], "--max-inflight") == 0) {
+                    max_inflight = limit;
+                } else if (strcmp(argv[i], "--max-queue-wait") == 0) {
+                    max_queue_wait_ms = limit;
+                } else {
+                    max_db_busy_ms = limit;
+                }
+                i++;
+            } else {
+                fprintf(stderr, "%s%s[CONFIG] %sInvalid value for %s, keeping default%s\n", 
+                        BOLD, COLOR_YELLOW, COLOR_RESET, argv[i], COLOR_RESET);
+            }
         } else if (strcmp(argv[i], "-n") == 0 || strcmp(argv[i], "--no-templates") == 0) {
             set_template_settings(false);
             printf("%s%s[CONFIG] %sTemplate processing disabled%s\n", 
@@ -281,6 +356,28 @@ int main(int argc, char *argv[]) {
             printf("%s%s[HELP]%s Usage: %s [OPTIONS]\n", BOLD, COLOR_BLUE, COLOR_RESET, argv[0]);
             printf("Options:\n");
             printf("  -p, --port PORT      Specify port number (default: %d)\n", PORT);
+            printf("  -w, --workers N      Threads for rendering and blocking work (SQLite, file reads), 0 runs inline (default: CPUs)\n");
+            printf("  -S, --shards N       SO_REUSEPORT listener/event loop pairs, one per CPU (default: 1)\n");
+            printf("      --cbpf           Steer each connection to the shard on the CPU that received it\n");
+            printf("      --unix PATH      Also listen on a Unix domain socket (for a local reverse proxy)\n");
+            printf("      --no-tcp         Only listen on the --unix socket\n");
+            printf("      --file-cache MB  Memory for cached file contents, 0 disables (default: %d)\n", FILE_CACHE_BUDGET_MB);
+            printf("      --fd-cache N     Static files kept open for sendfile, 0 disables (default: %d)\n", FD_CACHE_MAX_ENTRIES);
+            printf("      --no-compress    Do not build gzip/brotli variants of cached files\n");
+            printf("      --minify         Strip comments and extra whitespace from pages when loaded\n");
+            printf("      --cache          Send ETag/Last-Modified and answer conditional GETs with 304\n");
+            printf("      --production     No hot reload or per-request logging, implies --cache\n");
+            printf("      --backlog N      Listen queue length, capped by net.core.somaxconn (default: %d)\n", SOMAXCONN);
+            printf("      --defer-accept SEC   Wake on new connections only once data arrives, up to SEC (default: off)\n");
+            printf("      --loop-cpus LIST     Pin event loops to these CPUs, one each (e.g. 0-3,8)\n");
+            printf("      --worker-cpus LIST   Run worker threads on these CPUs\n");
+            printf("      --housekeeping-cpus LIST  Keep startup and other threads on these CPUs, away from the loops\n");
+            printf("      --rate-limit R[:B]    Per-IP HTTP requests per second, burst B (default: off, B = 2R)\n");
+            printf("      --ws-rate-limit R[:B] Per-IP WebSocket upgrades per second, burst B (default: off)\n");
+            printf("      --max-inflight N Shed requests with 503 past N in flight, 0 disables (default: %d)\n", ADMISSION_MAX_INFLIGHT);
+            printf("      --max-queue-wait MS  Shed when worker queue wait averages above MS (default: %d)\n", ADMISSION_MAX_QUEUE_WAIT_MS);
+            printf("      --max-db-busy MS     Shed query requests when SQLite queries average above MS (default: %d)\n", ADMISSION_MAX_DB_BUSY_MS);
+            printf("      --stats          Serve shedding and cache counters at " STATS_PATH " (default: off)\n");
             printf("  -s, --serve FILE     Specify a custom HTML file to serve\n");
             printf("  -db, --database FILE Specify SQLite database path\n");
             printf("  -n, --no-templates   Disable template processing\n");
@@ -289,6 +386,12 @@ int main(int argc, char *argv[]) {
         }
     }
     
+    if (PRODUCTION_MODE) {
+        configure_http_cache(true);
+        printf("%s%s[CONFIG] %sProduction mode: hot reload and per-request logging disabled%s\n", 
+               BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+    }
+
     #ifdef DEBUG_MODE
     printf("%s%s[DEBUG] %sCommand line arguments: custom_html_file=%s, db_path=%s%s\n", 
            BOLD, COLOR_CYAN, COLOR_RESET, 
@@ -337,6 +440,8 @@ int main(int argc, char *argv[]) {
     #endif
     
     set_server_port(port);   
+    configure_admission(max_inflight, max_queue_wait_ms, max_db_busy_ms);
+    configure_listen_sockets(backlog, defer_accept_sec);
     struct sigaction sa;
     memset(&sa, 0, sizeof(sa));
     sa.sa_handler = signal_handler;
@@ -344,6 +449,32 @@ int main(int argc, char *argv[]) {
     sigaction(SIGTERM, &sa, NULL);
     signal(SIGPIPE, SIG_IGN);
     
+    if (init_file_cache((size_t)file_cache_mb * 1024 * 1024) != 0) {
+        fprintf(stderr, "%s%s[WARNING] %sFailed to initialize file cache, reading from disk%s\n", 
+                BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+    }
+    init_fd_cache(fd_cache_entries, FD_CACHE_IDLE_SEC);
+
+    if (init_placement() != 0) {
+        cleanup_resources();
+        return EXIT_FAILURE;
+    }
+    if (placement_configured(PLACEMENT_LOOP) || placement_configured(PLACEMENT_WORKER) ||
+        placement_configured(PLACEMENT_HOUSEKEEPING)) {
+        char loop_cpus[128], worker_cpus[128], housekeeping_cpus[128];
+        format_placement(PLACEMENT_LOOP, loop_cpus, sizeof(loop_cpus));
+        format_placement(PLACEMENT_WORKER, worker_cpus, sizeof(worker_cpus));
+        format_placement(PLACEMENT_HOUSEKEEPING, housekeeping_cpus, sizeof(housekeeping_cpus));
+        printf("%s%s[PLACEMENT] %sLoops on CPUs %s%s%s, workers on %s%s%s, housekeeping on %s%s%s\n", 
+               BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, loop_cpus, COLOR_RESET,
+               COLOR_CYAN, worker_cpus, COLOR_RESET, COLOR_CYAN, housekeeping_cpus, COLOR_RESET);
+    }
+
+    if (init_compression(compress) != 0) {
+        fprintf(stderr, "%s%s[WARNING] %sFailed to start compression thread, serving uncompressed%s\n", 
+                BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+    }
+
     ws_clients = init_ws_clients();
     if (!ws_clients) {
         fprintf(stderr, "%s%s[ERROR] %sFailed to initialize WebSocket clients%s\n", 
@@ -352,55 +483,78 @@ int main(int argc, char *argv[]) {
         return EXIT_FAILURE;
     }
 
-    if (init_file_watcher(HTML_DIR, &file_changed, &file_mutex) != 0) {
-        fprintf(stderr, "%s%s[ERROR] %sFailed to initialize file watcher%s\n", 
+    if (init_route_table(HTML_DIR) != 0) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to build route table%s\n", 
                 BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
         cleanup_resources();
         return EXIT_FAILURE;
     }
 
-    watcher_thread = start_file_watcher(HTML_DIR, &file_changed, &file_mutex);
-    if (watcher_thread == 0) {
-        fprintf(stderr, "%s%s[ERROR] %sFailed to start file watcher thread%s\n", 
+#ifdef BLINK_EMBED_WWW
+    // Nothing on disk to watch, the web root is compiled in
+    printf("%s%s[SERVER] %sServing %s%zu%s embedded files, file watcher disabled%s\n", 
+           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_YELLOW, embedded_file_count(), COLOR_RESET, COLOR_RESET);
+#else
+    watch_fd = init_file_watcher(HTML_DIR);
+    if (watch_fd < 0) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to initialize file watcher%s\n", 
                 BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
         cleanup_resources();
         return EXIT_FAILURE;
     }
-    
-    monitor_args = malloc(sizeof(ws_monitor_args_t));
-    if (!monitor_args) {
-        fprintf(stderr, "%s%s[ERROR] %sFailed to allocate memory for WebSocket monitor: %s%s\n", 
-                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-        cleanup_resources();
-        return EXIT_FAILURE;
-    }
-    
-    monitor_args->clients = ws_clients;
-    monitor_args->file_changed = &file_changed;
-    monitor_args->mutex = &file_mutex;
-    if (pthread_create(&monitor_thread, NULL, ws_monitor_thread, monitor_args) != 0) {
-        fprintf(stderr, "%s%s[ERROR] %sFailed to create WebSocket monitor thread: %s%s\n", 
-                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-        cleanup_resources();
-        return EXIT_FAILURE;
+#endif
+
+    if (workers > 0) {
+        worker_pool = init_worker_pool(workers, process_connection_job, PLACEMENT_WORKER);
+        if (!worker_pool) {
+            fprintf(stderr, "%s%s[WARNING] %sFailed to start worker pool, rendering inline%s\n", 
+                    BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+            workers = 0;
+        }
     }
 
+    int inherited_fds[MAX_LISTENERS];
+    int inherited = take_inherited_listeners(inherited_fds, MAX_LISTENERS);
+    if (inherited > 0) {
+        shards = inherited;
+    } else {
+        if (!use_tcp && !unix_path) {
+            fprintf(stderr, "%s%s[ERROR] %s--no-tcp requires --unix PATH%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+            cleanup_resources();
+            return EXIT_FAILURE;
+        }
+        if (unix_path) {
+            unix_fd = initialize_unix_server(unix_path);
+            if (unix_fd < 0) {
+                cleanup_resources();
+                return EXIT_FAILURE;
+            }
+            printf("%s%s[SERVER] %sListening on unix socket %s%s%s\n", 
+                   BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, unix_path, COLOR_RESET);
+        }
+        if (!use_tcp) {
+            shards = 0;
+        }
+    }
 
-    memset(&address, 0, sizeof(address));
-    address.sin_family = AF_INET;
-    address.sin_addr.s_addr = INADDR_ANY;
-    address.sin_port = htons(port);
-    server_fd = initialize_server(&address);
-    if (server_fd == -1) {
+    shard_set = init_shards(shards, port, inherited > 0 ? inherited_fds : NULL, unix_fd, use_cbpf,
+                            watch_fd, HTML_DIR, ws_clients, worker_pool);
+    if (!shard_set) {
         cleanup_resources();
         return EXIT_FAILURE;
     }
 
-    int opt = 1;
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) < 0) {
-        fprintf(stderr, "%s%s[WARNING] %sError setting SO_REUSEADDR option: %s%s\n", 
-                BOLD, COLOR_YELLOW, COLOR_RESET, strerror(errno), COLOR_RESET);
+    int listen_fds[MAX_LISTENERS];
+    for (int i = 0; i < shard_set->count; i++) {
+        listen_fds[i] = shard_set->shards[i].listen_fd;
+    }
+    if (prepare_upgrade(argv, listen_fds, shard_set->count) == 0) {
+        sa.sa_handler = upgrade_handler;
+        sigaction(SIGUSR2, &sa, NULL);
     }
+    sa.sa_handler = drain_handler;
+    sigaction(SIGQUIT, &sa, NULL);
     
     printf("\n");
     printf("%s%s┏━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┓%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
@@ -414,8 +568,15 @@ int main(int argc, char *argv[]) {
     printf("%s%s┃  %sS E R V E R   S T A R T E D   %s               ┃%s\n", BOLD, COLOR_GREEN, COLOR_WHITE, COLOR_GREEN, COLOR_RESET);
     printf("%s%s┃                                               ┃%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
     printf("%s%s┃  %sPORT:%s %-37d  ┃%s\n", BOLD, COLOR_GREEN, COLOR_YELLOW, COLOR_CYAN, port, COLOR_RESET);
+    if (unix_path) {
+        printf("%s%s┃  %sUNIX:%s %-37.37s  ┃%s\n", BOLD, COLOR_GREEN, COLOR_YELLOW, COLOR_CYAN, unix_path, COLOR_RESET);
+    }
+    printf("%s%s┃                                               ┃%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
+    printf("%s%s┃  %sHOT RELOAD:%s %-31s  ┃%s\n", BOLD, COLOR_GREEN, COLOR_YELLOW, COLOR_CYAN, PRODUCTION_MODE ? "DISABLED (production)" : "ENABLED", COLOR_RESET);
+    printf("%s%s┃                                               ┃%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
+    printf("%s%s┃  %sSHARDS:%s %-35d  ┃%s\n", BOLD, COLOR_GREEN, COLOR_YELLOW, COLOR_CYAN, shards, COLOR_RESET);
     printf("%s%s┃                                               ┃%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
-    printf("%s%s┃  %sHOT RELOAD:%s %-31s  ┃%s\n", BOLD, COLOR_GREEN, COLOR_YELLOW, COLOR_CYAN, "ENABLED", COLOR_RESET);
+    printf("%s%s┃  %sWORKERS:%s %-34d  ┃%s\n", BOLD, COLOR_GREEN, COLOR_YELLOW, COLOR_CYAN, workers, COLOR_RESET);
     printf("%s%s┃                                               ┃%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
     printf("%s%s┃  %sTEMPLATES:%s %-32s  ┃%s\n", BOLD, COLOR_GREEN, COLOR_YELLOW, COLOR_CYAN, enable_templates ? "ENABLED" : "DISABLED", COLOR_RESET);
     printf("%s%s┃                                               ┃%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
@@ -426,80 +587,20 @@ int main(int argc, char *argv[]) {
     printf("%s%s┃                                               ┃%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
     printf("%s%s┗━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━━┛%s\n", BOLD, COLOR_GREEN, COLOR_RESET);
     printf("\n");
-    printf("%s%s[SERVER] %sPress Ctrl+C to stop the server%s\n", BOLD, COLOR_BLUE, COLOR_RESET, COLOR_RESET);
+    printf("%s%s[SERVER] %sPress Ctrl+C to stop the server, send SIGUSR2 to pid %d to upgrade in place%s\n",
+           BOLD, COLOR_BLUE, COLOR_RESET, (int)getpid(), COLOR_RESET);
 
-    fd_set read_fds;
-    struct timeval timeout;
-    int max_fd = server_fd;
-    time_t last_ping_time = 0;
-    const int PING_INTERVAL_MS = 5000;
-
-    while (server_running) {
-        if (!server_running) {
-            printf("%s%s[SERVER] %sShutdown signal received, exiting main loop...%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_RESET);
-            break;
-        }
-        
-        FD_ZERO(&read_fds);
-        FD_SET(server_fd, &read_fds);
-        timeout.tv_sec = 0; 
-        timeout.tv_usec = 100000;
-        int activity = select(max_fd + 1, &read_fds, NULL, NULL, &timeout);
-        
-        if (!server_running) {
-            break;
-        }
-        
-        if (activity < 0) {
-            if (errno == EINTR) {
-                if (!server_running) {
-                    break;
-                }
-                continue;
-            }
-            fprintf(stderr, "%s%s[ERROR] %sSelect error: %s%s\n", 
-                    BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-            break;
-        }
-        
-        time_t current_time = time(NULL);
-        if (ws_clients && server_running && ws_clients->count > 0 && 
-            difftime(current_time, last_ping_time) * 1000 >= PING_INTERVAL_MS) {
-            broadcast_to_ws_clients(ws_clients, "ping");
-            last_ping_time = current_time;
-        }
-        
-        if (activity > 0 && FD_ISSET(server_fd, &read_fds) && server_running) {
-            if ((new_socket = accept(server_fd, (struct sockaddr*)&address, (socklen_t*)&addrlen)) < 0) {
-                if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                    continue;
-                }
-                fprintf(stderr, "%s%s[ERROR] %sConnection not accepted: %s%s\n", 
-                        BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
-                continue;
-            }
-            
-            char buffer[BUFFER_SIZE] = {0};
-            ssize_t bytes_read = recv(new_socket, buffer, BUFFER_SIZE, MSG_PEEK);
-            if (bytes_read > 0) {
-                buffer[bytes_read < BUFFER_SIZE ? bytes_read : BUFFER_SIZE-1] = '\0';
-                if (is_websocket_request(buffer)) {
-                    handle_websocket_client(new_socket, ws_clients);
-                } else {
-                    handle_client(new_socket);
-                }
-            } else {
-                close(new_socket);
-            }
-        }
-    }
+    notify_upgrade_parent();
+    run_shards(shard_set, &server_running, &server_draining);
     
-
-    if (server_fd != -1) {
-        close(server_fd);
-        server_fd = -1;
+    free_worker_pool(worker_pool);
+    worker_pool = NULL;
+    free_shards(shard_set);
+    shard_set = NULL;
+    if (unix_path && !server_draining) {
+        unlink(unix_path);
     }
+
     cleanup_resources();  
     printf("%s%s[SERVER] %s%sServer shut down gracefully%s\n", 
            BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET);
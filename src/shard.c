@@ -0,0 +1,149 @@
+#define _GNU_SOURCE
+#include "shard.h"
+#include "placement.h"
+#include "socket_utils.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void* shard_main(void* arg) {
+    shard_t* shard = (shard_t*)arg;
+
+    place_thread(PLACEMENT_LOOP, shard->cpu);
+    run_event_loop(shard->loop, shard->running, shard->draining);
+    return NULL;
+}
+
+static bool is_tcp_listener(int fd) {
+    struct sockaddr_storage address;
+    socklen_t len = sizeof(address);
+    return getsockname(fd, (struct sockaddr*)&address, &len) == 0 && address.ss_family == AF_INET;
+}
+
+shard_set_t* init_shards(int count, int port, const int* listen_fds, int unix_fd, bool use_cbpf,
+                         int watch_fd, const char* watch_dir, ws_clients_t* clients,
+                         worker_pool_t* workers) {
+    int total = count + (unix_fd >= 0 ? 1 : 0);
+    shard_set_t* set = calloc(1, sizeof(shard_set_t));
+    if (!set) {
+        return NULL;
+    }
+
+    set->shards = calloc(total, sizeof(shard_t));
+    if (!set->shards) {
+        free(set);
+        return NULL;
+    }
+
+    set->pinned = total > 1 || placement_configured(PLACEMENT_LOOP);
+    for (int i = 0; i < total; i++) {
+        shard_t* shard = &set->shards[i];
+        struct sockaddr_in address;
+
+        memset(&address, 0, sizeof(address));
+        address.sin_family = AF_INET;
+        address.sin_addr.s_addr = INADDR_ANY;
+        address.sin_port = htons(port);
+
+        shard->index = i;
+        shard->cpu = placement_cpu(PLACEMENT_LOOP, i);
+        if (i == count) {
+            shard->listen_fd = unix_fd;
+        } else {
+            shard->listen_fd = listen_fds ? listen_fds[i] : initialize_server(&address);
+        }
+        if (listen_fds && shard->listen_fd >= 0) {
+            tune_listener(shard->listen_fd);
+        }
+        if (shard->listen_fd == -1) {
+            free_shards(set);
+            return NULL;
+        }
+        set->count++;
+
+        // Allocate the loop from the node it will run on
+        if (set->pinned) {
+            place_thread(PLACEMENT_LOOP, shard->cpu);
+        }
+        shard->loop = init_event_loop(shard->listen_fd, i == 0 ? watch_fd : -1, watch_dir,
+                                      clients, workers);
+        if (!shard->loop) {
+            free_shards(set);
+            return NULL;
+        }
+    }
+
+    if (set->pinned) {
+        place_thread(PLACEMENT_HOUSEKEEPING, -1);
+    }
+
+    for (int i = 0; use_cbpf && i < set->count; i++) {
+        if (!is_tcp_listener(set->shards[i].listen_fd)) {
+            continue;
+        }
+        for (int j = 0; j < count; j++) {
+            if (set->shards[j].cpu != j) {
+                fprintf(stderr, "%s%s[WARNING] %sCBPF steering expects shard N on CPU N, shard %d is on CPU %d%s\n",
+                        BOLD, COLOR_YELLOW, COLOR_RESET, j, set->shards[j].cpu, COLOR_RESET);
+                break;
+            }
+        }
+        if (attach_reuseport_cbpf(set->shards[i].listen_fd) == 0) {
+            printf("%s%s[SHARDS] %sCBPF steering attached (connections stay on the receiving CPU)%s\n",
+                   BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_RESET);
+        }
+        break;
+    }
+
+    if (count > 1) {
+        printf("%s%s[SHARDS] %sStarted %s%d%s SO_REUSEPORT listeners%s\n",
+               BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, count, COLOR_GREEN, COLOR_RESET);
+    }
+    return set;
+}
+
+void run_shards(shard_set_t* set, volatile sig_atomic_t* running, volatile sig_atomic_t* draining) {
+    for (int i = 1; i < set->count; i++) {
+        shard_t* shard = &set->shards[i];
+        shard->running = running;
+        shard->draining = draining;
+        if (pthread_create(&shard->thread, NULL, shard_main, shard) != 0) {
+            fprintf(stderr, "%s%s[ERROR] %sFailed to start shard %d: %s%s\n",
+                    BOLD, COLOR_RED, COLOR_RESET, i, strerror(errno), COLOR_RESET);
+            continue;
+        }
+        shard->thread_started = true;
+    }
+
+    if (set->pinned) {
+        place_thread(PLACEMENT_LOOP, set->shards[0].cpu);
+    }
+    run_event_loop(set->shards[0].loop, running, draining);
+
+    for (int i = 1; i < set->count; i++) {
+        if (set->shards[i].thread_started) {
+            pthread_join(set->shards[i].thread, NULL);
+            set->shards[i].thread_started = false;
+        }
+    }
+}
+
+void free_shards(shard_set_t* set) {
+    if (!set) {
+        return;
+    }
+
+    for (int i = 0; i < set->count; i++) {
+        shard_t* shard = &set->shards[i];
+        free_event_loop(shard->loop);
+        shard->loop = NULL;
+        if (shard->listen_fd >= 0) {
+            close(shard->listen_fd);
+            shard->listen_fd = -1;
+        }
+    }
+
+    free(set->shards);
+    free(set);
+}
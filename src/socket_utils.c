@@ -1,5 +1,34 @@
 #include "socket_utils.h"
 #include <errno.h>
+#include <stdbool.h>
+#include <sys/stat.h>
+#include <linux/filter.h>
+#include <netinet/tcp.h>
+
+static int listen_backlog = SOMAXCONN;
+static int defer_accept_sec = DEFER_ACCEPT_SEC;
+
+void configure_listen_sockets(int backlog, int defer_sec) {
+    listen_backlog = backlog > 0 ? backlog : SOMAXCONN;
+    defer_accept_sec = defer_sec;
+}
+
+// Also applied to inherited listeners, listen() again only resizes the queue
+int tune_listener(int server_fd) {
+    struct sockaddr_storage address;
+    socklen_t len = sizeof(address);
+
+    if (listen(server_fd, listen_backlog) < 0) {
+        perror("Listen failed!");
+        return -1;
+    }
+
+    if (getsockname(server_fd, (struct sockaddr*)&address, &len) == 0 && address.ss_family != AF_UNIX &&
+        setsockopt(server_fd, IPPROTO_TCP, TCP_DEFER_ACCEPT, &defer_accept_sec, sizeof(defer_accept_sec)) != 0) {
+        perror("TCP_DEFER_ACCEPT failed");
+    }
+    return 0;
+}
 
 int initialize_server(struct sockaddr_in* address) {
     int server_fd;
@@ -8,12 +37,13 @@ int initialize_server(struct sockaddr_in* address) {
     const int MAX_RETRIES = 5;
     const int RETRY_DELAY_SEC = 2;
     int port = ntohs(address->sin_port);
-    if ((server_fd = socket(AF_INET, SOCK_STREAM, 0)) == 0) {
+    if ((server_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
         perror("Socket failed!");
         return -1;
     }
 
-    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
+    if (setsockopt(server_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0 ||
+        setsockopt(server_fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
         perror("setsockopt failed"); 
         close(server_fd); 
         return -1;
@@ -43,14 +73,100 @@ int initialize_server(struct sockaddr_in* address) {
         close(server_fd);
         return -1;
     }
-    if (listen(server_fd, 3) < 0) {
-        perror("Listen failed!");  
+    if (tune_listener(server_fd) < 0) {
         close(server_fd);          
         return -1;
     }
     return server_fd;  
 }
 
+static bool unix_socket_in_use(const struct sockaddr_un* address) {
+    struct stat st;
+    if (lstat(address->sun_path, &st) != 0 || !S_ISSOCK(st.st_mode)) {
+        return true;
+    }
+
+    int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (probe < 0) {
+        return true;
+    }
+
+    bool in_use = connect(probe, (const struct sockaddr*)address, sizeof(*address)) == 0 ||
+                  errno != ECONNREFUSED;
+    close(probe);
+    return in_use;
+}
+
+int initialize_unix_server(const char* path) {
+    struct sockaddr_un address;
+    int server_fd;
+
+    if (strlen(path) >= sizeof(address.sun_path)) {
+        fprintf(stderr, "Unix socket path too long: %s\n", path);
+        return -1;
+    }
+
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+    strcpy(address.sun_path, path);
+
+    if ((server_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) {
+        perror("Unix socket failed!");
+        return -1;
+    }
+
+    if (bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+        if (errno != EADDRINUSE || unix_socket_in_use(&address) ||
+            unlink(path) != 0 || bind(server_fd, (struct sockaddr*)&address, sizeof(address)) < 0) {
+            fprintf(stderr, "Failed to bind unix socket %s: %s\n", path, strerror(errno));
+            close(server_fd);
+            return -1;
+        }
+    }
+
+    if (tune_listener(server_fd) < 0) {
+        close(server_fd);
+        unlink(path);
+        return -1;
+    }
+    return server_fd;
+}
+
+int attach_reuseport_cbpf(int server_fd) {
+    struct sock_filter code[] = {
+        { BPF_LD | BPF_W | BPF_ABS, 0, 0, SKF_AD_OFF + SKF_AD_CPU },
+        { BPF_RET | BPF_A, 0, 0, 0 },
+    };
+    struct sock_fprog prog = {
+        .len = sizeof(code) / sizeof(code[0]),
+        .filter = code,
+    };
+
+    if (setsockopt(server_fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof(prog)) != 0) {
+        perror("SO_ATTACH_REUSEPORT_CBPF failed");
+        return -1;
+    }
+    return 0;
+}
+
+uint64_t peer_address_key(const struct sockaddr* address) {
+    if (address->sa_family == AF_INET) {
+        const struct sockaddr_in* in = (const struct sockaddr_in*)address;
+        return (1ULL << 32) | ntohl(in->sin_addr.s_addr);
+    }
+
+    if (address->sa_family == AF_INET6) {
+        const struct sockaddr_in6* in6 = (const struct sockaddr_in6*)address;
+        uint64_t hash = 0xcbf29ce484222325ULL;
+        for (int i = 0; i < 16; i++) {
+            hash = (hash ^ in6->sin6_addr.s6_addr[i]) * 0x100000001b3ULL;
+        }
+        return hash | (1ULL << 63);
+    }
+
+    return 0;
+}
+
 void read_client_data(int socket, char* buffer) {
     ssize_t read_value;
     while ((read_value = read(socket, buffer, BUFFER_SIZE)) > 0) {
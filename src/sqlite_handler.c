@@ -2,6 +2,8 @@
 #include <regex.h>
 #include "server.h"
 #include "debug.h"
+#include "admission.h"
+#include "coroutine.h"
 
 static sqlite3* db = NULL;
 static char* db_path = NULL;
@@ -129,7 +131,12 @@ static int callback(void* data, int argc, char** argv, char** azColName) {
     return 0;
 }
 
-sqlite_result_t* execute_query(const char* query) {
+typedef struct {
+    const char* query;
+    sqlite_result_t* result;
+} query_job_t;
+
+static sqlite_result_t* execute_query_now(const char* query) {
     if (!db_initialized || db == NULL) {
         fprintf(stderr, "%s%s[SQLite] %sDatabase not initialized%s\n", 
                 BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
@@ -146,10 +153,12 @@ sqlite_result_t* execute_query(const char* query) {
     memset(result, 0, sizeof(sqlite_result_t));
     
     char* err_msg = NULL;
-    printf("%s%s[SQLite] %sExecuting query: %s%s%s\n", 
-           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, query, COLOR_RESET);
+    REQUEST_LOG("%s%s[SQLite] %sExecuting query: %s%s%s\n", 
+                BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, query, COLOR_RESET);
     
+    long long started = monotonic_us();
     int rc = sqlite3_exec(db, query, callback, result, &err_msg);
+    record_db_busy(monotonic_us() - started);
     
     if (rc != SQLITE_OK) {
         fprintf(stderr, "%s%s[SQLite] %s%sSQL error: %s%s\n", 
@@ -162,6 +171,17 @@ sqlite_result_t* execute_query(const char* query) {
     return result;
 }
 
+static void run_query_job(void* arg) {
+    query_job_t* job = (query_job_t*)arg;
+    job->result = execute_query_now(job->query);
+}
+
+sqlite_result_t* execute_query(const char* query) {
+    query_job_t job = { query, NULL };
+    run_blocking(run_query_job, &job);
+    return job.result;
+}
+
 void free_query_results(sqlite_result_t* results) {
     if (results == NULL) {
         return;
@@ -0,0 +1,104 @@
+#include "static_files.h"
+#include "static_types.h"
+#include "coroutine.h"
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+typedef struct {
+    const char* extension;
+    const char* content_type;
+    const char* headers;
+    bool compressible;
+} static_type_t;
+
+#define STATIC_TYPE(ext, type, compressible) { ext, type, "Content-Type: " type "\r\n", compressible },
+
+static const static_type_t static_types[] = {
+    STATIC_TYPES(STATIC_TYPE)
+};
+
+typedef struct {
+    const char* path;
+    fd_cache_entry_t* entry;
+} open_job_t;
+
+static const static_type_t* find_static_type(const char* path) {
+    const char* slash = strrchr(path, '/');
+    const char* ext = strrchr(slash ? slash : path, '.');
+    if (!ext) {
+        return NULL;
+    }
+
+    for (size_t i = 0; i < sizeof(static_types) / sizeof(static_types[0]); i++) {
+        if (strcasecmp(ext, static_types[i].extension) == 0) {
+            return &static_types[i];
+        }
+    }
+    return NULL;
+}
+
+const char* get_content_type(const char* path) {
+    const static_type_t* type = find_static_type(path);
+    if (type) {
+        return type->content_type;
+    }
+    const char* ext = strrchr(path, '.');
+    return ext && strcmp(ext, ".html") == 0 ? "text/html" : "application/octet-stream";
+}
+
+const char* static_asset_headers(const char* path) {
+    const static_type_t* type = find_static_type(path);
+    return type ? type->headers : NULL;
+}
+
+bool static_asset_compressible(const char* path) {
+    const static_type_t* type = find_static_type(path);
+    return type && type->compressible;
+}
+
+// Rejects "..", dotfiles and anything else starting with '.'
+static bool safe_asset_path(const char* path) {
+    if (path[0] != '/') {
+        return false;
+    }
+    for (const char* p = path; (p = strchr(p, '/')) != NULL; p++) {
+        if (p[1] == '.' || p[1] == '/' || p[1] == '\0') {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void run_open_job(void* arg) {
+    open_job_t* job = (open_job_t*)arg;
+    job->entry = fd_cache_open(job->path);
+}
+
+int static_asset_path(const char* root, const char* path, char* out, size_t size) {
+    if (!safe_asset_path(path)) {
+        return -1;
+    }
+
+    int written = snprintf(out, size, "%s%s", root, path);
+    if (written < 0 || (size_t)written >= size) {
+        return -1;
+    }
+    return written;
+}
+
+fd_cache_entry_t* open_static_asset(const char* root, const char* path) {
+    char full_path[512];
+    if (static_asset_path(root, path, full_path, sizeof(full_path)) < 0) {
+        return NULL;
+    }
+
+    fd_cache_entry_t* entry = fd_cache_lookup(full_path);
+    if (entry) {
+        return entry;
+    }
+
+    open_job_t job = { full_path, NULL };
+    run_blocking(run_open_job, &job);
+    return job.entry;
+}
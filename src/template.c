@@ -1,4 +1,5 @@
 #include "template.h"
+#include "debug.h"
 
 char* replace_placeholders(char* result, const char** keys, const char** values, int num_pairs) {
     if (!result) return NULL;
@@ -593,16 +594,16 @@ char* process_loops(char* result, const char* loop_key, const char** loop_values
 char* process_template(const char* template, const char** keys, const char** values, int num_pairs, const char* loop_key, const char** loop_values, int loop_count) {
     if (!template) return NULL;
     
-    printf("Processing template with %d key-value pairs\n", num_pairs);
+    REQUEST_LOG("Processing template with %d key-value pairs\n", num_pairs);
     
     if (keys == NULL || values == NULL) {
-        printf("Warning: NULL keys or values array passed to process_template\n");
+        REQUEST_LOG("Warning: NULL keys or values array passed to process_template\n");
         return strdup(template);
     }
     
     for (int i = 0; i < num_pairs; i++) {
         if (keys[i] == NULL) {
-            printf("Warning: NULL key at index %d\n", i);
+            REQUEST_LOG("Warning: NULL key at index %d\n", i);
             continue;
         }
     }
@@ -613,33 +614,33 @@ char* process_template(const char* template, const char** keys, const char** val
         return NULL;
     }
     
-    printf("Applying placeholder replacements...\n");
+    REQUEST_LOG("Applying placeholder replacements...\n");
     char* temp = replace_placeholders(result, keys, values, num_pairs);
     if (temp) {
         result = temp;
     } else {
-        printf("Warning: Placeholder replacement failed, continuing with original content\n");
+        REQUEST_LOG("Warning: Placeholder replacement failed, continuing with original content\n");
     }
     
-    printf("Applying conditional logic...\n");
+    REQUEST_LOG("Applying conditional logic...\n");
     temp = process_if_else(result, keys, values, num_pairs);
     if (temp) {
         result = temp;
     } else {
-        printf("Warning: If-else processing failed, continuing with current content\n");
+        REQUEST_LOG("Warning: If-else processing failed, continuing with current content\n");
     }
     
     if (loop_key && loop_values && loop_count > 0) {
-        printf("Applying loops for key '%s' with %d items...\n", loop_key, loop_count);
+        REQUEST_LOG("Applying loops for key '%s' with %d items...\n", loop_key, loop_count);
     temp = process_loops(result, loop_key, loop_values, loop_count);
         if (temp) {
             result = temp;
         } else {
-            printf("Warning: Loop processing failed, continuing with current content\n");
+            REQUEST_LOG("Warning: Loop processing failed, continuing with current content\n");
         }
     }
     
-    printf("Template processing complete\n");
+    REQUEST_LOG("Template processing complete\n");
     return result;
 }
 
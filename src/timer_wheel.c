@@ -0,0 +1,161 @@
+#include "timer_wheel.h"
+#include <stddef.h>
+
+#define LEVEL_SHIFT(level) (TIMER_WHEEL_BITS * (level))
+#define WHEEL_SPAN (1ULL << LEVEL_SHIFT(TIMER_WHEEL_LEVELS))
+
+static void list_init(timer_node_t* head) {
+    head->prev = head;
+    head->next = head;
+}
+
+static void list_append(timer_node_t* head, timer_node_t* node) {
+    node->prev = head->prev;
+    node->next = head;
+    head->prev->next = node;
+    head->prev = node;
+}
+
+static void list_unlink(timer_node_t* node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    node->prev = NULL;
+    node->next = NULL;
+}
+
+static void place_timer(timer_wheel_t* wheel, timer_node_t* timer) {
+    uint64_t expires = timer->expires > wheel->now ? timer->expires : wheel->now + 1;
+    uint64_t delta = expires - wheel->now;
+    if (delta >= WHEEL_SPAN) {
+        expires = wheel->now + WHEEL_SPAN - 1;
+        delta = WHEEL_SPAN - 1;
+    }
+
+    int level = 0;
+    while (level < TIMER_WHEEL_LEVELS - 1 && delta >= (1ULL << LEVEL_SHIFT(level + 1))) {
+        level++;
+    }
+
+    int slot = (int)((expires >> LEVEL_SHIFT(level)) & TIMER_WHEEL_MASK);
+    list_append(&wheel->slots[level][slot], timer);
+}
+
+static void take_slot(timer_node_t* slot, timer_node_t* out) {
+    list_init(out);
+    if (slot->next == slot) {
+        return;
+    }
+
+    out->next = slot->next;
+    out->prev = slot->prev;
+    out->next->prev = out;
+    out->prev->next = out;
+    list_init(slot);
+}
+
+static void cascade(timer_wheel_t* wheel, int level, int slot) {
+    timer_node_t pending;
+    take_slot(&wheel->slots[level][slot], &pending);
+
+    while (pending.next != &pending) {
+        timer_node_t* timer = pending.next;
+        list_unlink(timer);
+        place_timer(wheel, timer);
+    }
+}
+
+static void run_expired(timer_wheel_t* wheel, int slot) {
+    timer_node_t expired;
+    take_slot(&wheel->slots[0][slot], &expired);
+
+    while (expired.next != &expired) {
+        timer_node_t* timer = expired.next;
+        list_unlink(timer);
+        if (timer->expires > wheel->now) {
+            place_timer(wheel, timer);
+            continue;
+        }
+
+        wheel->count--;
+        timer->callback(timer->data);
+    }
+}
+
+void init_timer_wheel(timer_wheel_t* wheel, uint64_t now_ms) {
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        for (int slot = 0; slot < TIMER_WHEEL_SLOTS; slot++) {
+            list_init(&wheel->slots[level][slot]);
+        }
+    }
+    wheel->now = now_ms;
+    wheel->count = 0;
+}
+
+void init_timer(timer_node_t* timer, timer_fn callback, void* data) {
+    timer->prev = NULL;
+    timer->next = NULL;
+    timer->expires = 0;
+    timer->callback = callback;
+    timer->data = data;
+}
+
+void timer_arm(timer_wheel_t* wheel, timer_node_t* timer, uint64_t expires_ms) {
+    timer_cancel(wheel, timer);
+    timer->expires = expires_ms;
+    place_timer(wheel, timer);
+    wheel->count++;
+}
+
+void timer_cancel(timer_wheel_t* wheel, timer_node_t* timer) {
+    if (!timer_pending(timer)) {
+        return;
+    }
+
+    list_unlink(timer);
+    wheel->count--;
+}
+
+bool timer_pending(const timer_node_t* timer) {
+    return timer->next != NULL;
+}
+
+void advance_timer_wheel(timer_wheel_t* wheel, uint64_t now_ms) {
+    if (wheel->count == 0) {
+        if (now_ms > wheel->now) {
+            wheel->now = now_ms;
+        }
+        return;
+    }
+
+    while (wheel->now < now_ms) {
+        if (wheel->count == 0) {
+            wheel->now = now_ms;
+            break;
+        }
+
+        uint64_t tick = ++wheel->now;
+        for (int level = 1; level < TIMER_WHEEL_LEVELS; level++) {
+            if (tick & ((1ULL << LEVEL_SHIFT(level)) - 1)) {
+                break;
+            }
+            cascade(wheel, level, (int)((tick >> LEVEL_SHIFT(level)) & TIMER_WHEEL_MASK));
+        }
+        run_expired(wheel, (int)(tick & TIMER_WHEEL_MASK));
+    }
+}
+
+int timer_wheel_next_timeout(const timer_wheel_t* wheel, int max_ms) {
+    if (wheel->count == 0) {
+        return max_ms;
+    }
+
+    int until_cascade = TIMER_WHEEL_SLOTS - (int)(wheel->now & TIMER_WHEEL_MASK);
+    int limit = until_cascade < max_ms ? until_cascade : max_ms;
+    for (int ticks = 1; ticks < limit; ticks++) {
+        const timer_node_t* slot = &wheel->slots[0][(wheel->now + ticks) & TIMER_WHEEL_MASK];
+        if (slot->next != slot) {
+            return ticks;
+        }
+    }
+    return limit;
+}
@@ -0,0 +1,175 @@
+#include "upgrade.h"
+#include "shard.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern char** environ;
+
+static char upgrade_path[PATH_MAX];
+static char** upgrade_argv = NULL;
+static char** upgrade_envp = NULL;
+static char* upgrade_fds_var = NULL;
+static char* upgrade_pid_var = NULL;
+static int upgrade_fds[MAX_LISTENERS];
+static int upgrade_fd_count = 0;
+static pid_t upgrade_parent = 0;
+
+static bool is_listening_socket(int fd) {
+    struct stat st;
+    int listening = 0;
+    socklen_t len = sizeof(listening);
+
+    if (fstat(fd, &st) != 0 || !S_ISSOCK(st.st_mode)) {
+        return false;
+    }
+    if (getsockopt(fd, SOL_SOCKET, SO_ACCEPTCONN, &listening, &len) != 0) {
+        return false;
+    }
+    return listening != 0;
+}
+
+static bool has_env_prefix(const char* entry, const char* name) {
+    size_t len = strlen(name);
+    return strncmp(entry, name, len) == 0 && entry[len] == '=';
+}
+
+int take_inherited_listeners(int* fds, int max) {
+    const char* list = getenv(LISTEN_FDS_ENV);
+    const char* parent = getenv(UPGRADE_PARENT_ENV);
+    int count = 0;
+
+    if (parent) {
+        pid_t pid = (pid_t)atoi(parent);
+        if (pid > 0 && pid == getppid()) {
+            upgrade_parent = pid;
+        }
+    }
+
+    if (list) {
+        const char* cursor = list;
+        while (*cursor && count < max) {
+            char* end;
+            long fd = strtol(cursor, &end, 10);
+            if (end == cursor) {
+                break;
+            }
+
+            if (fd > STDERR_FILENO && fd <= INT_MAX && is_listening_socket((int)fd)) {
+                fcntl((int)fd, F_SETFD, FD_CLOEXEC);
+                fds[count++] = (int)fd;
+            } else {
+                fprintf(stderr, "%s%s[UPGRADE] %sIgnoring inherited fd %ld, not a listening socket%s\n",
+                        BOLD, COLOR_YELLOW, COLOR_RESET, fd, COLOR_RESET);
+            }
+            cursor = *end == ',' ? end + 1 : end;
+        }
+    }
+
+    unsetenv(LISTEN_FDS_ENV);
+    unsetenv(UPGRADE_PARENT_ENV);
+
+    if (count > 0) {
+        printf("%s%s[UPGRADE] %sInherited %s%d%s listening socket(s)%s\n",
+               BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, count, COLOR_GREEN, COLOR_RESET);
+    }
+    return count;
+}
+
+int prepare_upgrade(char* argv[], const int* fds, int count) {
+    ssize_t len = readlink("/proc/self/exe", upgrade_path, sizeof(upgrade_path) - 1);
+    if (len <= 0 || count > MAX_LISTENERS) {
+        fprintf(stderr, "%s%s[WARNING] %sHot upgrade unavailable: cannot resolve executable%s\n",
+                BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+        return -1;
+    }
+    upgrade_path[len] = '\0';
+
+    size_t fds_size = strlen(LISTEN_FDS_ENV) + 2 + (size_t)count * 12;
+    upgrade_fds_var = malloc(fds_size);
+    upgrade_pid_var = malloc(strlen(UPGRADE_PARENT_ENV) + 24);
+
+    size_t env_count = 0;
+    while (environ[env_count]) {
+        env_count++;
+    }
+    upgrade_envp = calloc(env_count + 3, sizeof(char*));
+
+    if (!upgrade_fds_var || !upgrade_pid_var || !upgrade_envp) {
+        free_upgrade();
+        return -1;
+    }
+
+    size_t offset = (size_t)snprintf(upgrade_fds_var, fds_size, "%s=", LISTEN_FDS_ENV);
+    for (int i = 0; i < count; i++) {
+        offset += (size_t)snprintf(upgrade_fds_var + offset, fds_size - offset,
+                                   i == 0 ? "%d" : ",%d", fds[i]);
+        upgrade_fds[i] = fds[i];
+    }
+    upgrade_fd_count = count;
+    sprintf(upgrade_pid_var, "%s=%d", UPGRADE_PARENT_ENV, (int)getpid());
+
+    size_t out = 0;
+    for (size_t i = 0; i < env_count; i++) {
+        if (has_env_prefix(environ[i], LISTEN_FDS_ENV) || has_env_prefix(environ[i], UPGRADE_PARENT_ENV)) {
+            continue;
+        }
+        upgrade_envp[out++] = environ[i];
+    }
+    upgrade_envp[out++] = upgrade_fds_var;
+    upgrade_envp[out++] = upgrade_pid_var;
+    upgrade_envp[out] = NULL;
+
+    upgrade_argv = argv;
+    return 0;
+}
+
+pid_t spawn_upgrade(void) {
+    if (!upgrade_envp) {
+        return -1;
+    }
+
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+
+    sigset_t none;
+    sigemptyset(&none);
+    sigprocmask(SIG_SETMASK, &none, NULL);
+    for (int i = 0; i < upgrade_fd_count; i++) {
+        fcntl(upgrade_fds[i], F_SETFD, 0);
+    }
+
+    execve(upgrade_path, upgrade_argv, upgrade_envp);
+    _exit(127);
+}
+
+void notify_upgrade_parent(void) {
+    if (upgrade_parent <= 0) {
+        return;
+    }
+
+    if (kill(upgrade_parent, SIGQUIT) == 0) {
+        printf("%s%s[UPGRADE] %sTook over from process %s%d%s, asked it to drain%s\n",
+               BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, (int)upgrade_parent, COLOR_GREEN, COLOR_RESET);
+    }
+    upgrade_parent = 0;
+}
+
+void free_upgrade(void) {
+    free(upgrade_envp);
+    free(upgrade_fds_var);
+    free(upgrade_pid_var);
+    upgrade_envp = NULL;
+    upgrade_fds_var = NULL;
+    upgrade_pid_var = NULL;
+    upgrade_argv = NULL;
+    upgrade_fd_count = 0;
+}
@@ -0,0 +1,534 @@
+#define _GNU_SOURCE
+#include "uring_loop.h"
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#define URING_OP_MASK 0xFULL
+
+enum {
+    URING_OP_ACCEPT = 1,
+    URING_OP_RECV,
+    URING_OP_SEND,
+    URING_OP_WS_POLL,
+    URING_OP_NOTIFY,
+    URING_OP_WATCH,
+    URING_OP_CANCEL,
+    URING_OP_FILE_POLL
+};
+
+struct uring_backend {
+    int ring_fd;
+    unsigned sq_entries;
+    void* ring_ptr;
+    size_t ring_size;
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_mask;
+    unsigned* sq_array;
+    struct io_uring_sqe* sqes;
+    size_t sqes_size;
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned* cq_mask;
+    struct io_uring_cqe* cqes;
+    unsigned to_submit;
+    struct io_uring_buf_ring* buf_ring;
+    size_t buf_ring_size;
+    char* buffers;
+};
+
+static int uring_setup(unsigned entries, struct io_uring_params* params) {
+    return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static int uring_enter(int ring_fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                       struct io_uring_getevents_arg* arg) {
+    return (int)syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags,
+                        arg, arg ? sizeof(*arg) : 0);
+}
+
+static int uring_register(int ring_fd, unsigned opcode, void* arg, unsigned nr_args) {
+    return (int)syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args);
+}
+
+static int flush_submissions(struct uring_backend* ring, int wait_ms) {
+    struct __kernel_timespec timeout;
+    struct io_uring_getevents_arg arg;
+    int submitted;
+
+    if (wait_ms < 0) {
+        submitted = uring_enter(ring->ring_fd, ring->to_submit, 0, 0, NULL);
+    } else {
+        timeout.tv_sec = wait_ms / 1000;
+        timeout.tv_nsec = (wait_ms % 1000) * 1000000LL;
+        memset(&arg, 0, sizeof(arg));
+        arg.ts = (uint64_t)(uintptr_t)&timeout;
+        submitted = uring_enter(ring->ring_fd, ring->to_submit, 1,
+                                IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg);
+    }
+
+    if (submitted >= 0) {
+        ring->to_submit -= (unsigned)submitted;
+    }
+    return submitted;
+}
+
+static struct io_uring_sqe* get_sqe(struct uring_backend* ring) {
+    for (;;) {
+        unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        unsigned tail = *ring->sq_tail;
+        if (tail - head < ring->sq_entries) {
+            struct io_uring_sqe* sqe = &ring->sqes[tail & *ring->sq_mask];
+            memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+        if (flush_submissions(ring, -1) < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            return NULL;
+        }
+    }
+}
+
+static void queue_sqe(struct uring_backend* ring) {
+    unsigned tail = *ring->sq_tail;
+    unsigned index = tail & *ring->sq_mask;
+    ring->sq_array[index] = index;
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+}
+
+static uint64_t make_user_data(void* ptr, unsigned op) {
+    return (uint64_t)(uintptr_t)ptr | op;
+}
+
+static void recycle_buffer(struct uring_backend* ring, unsigned short bid) {
+    unsigned short tail = ring->buf_ring->tail;
+    struct io_uring_buf* buf = &ring->buf_ring->bufs[tail & (URING_BUFFER_COUNT - 1)];
+
+    buf->addr = (uint64_t)(uintptr_t)(ring->buffers + (size_t)bid * URING_BUFFER_SIZE);
+    buf->len = URING_BUFFER_SIZE;
+    buf->bid = bid;
+    __atomic_store_n(&ring->buf_ring->tail, (unsigned short)(tail + 1), __ATOMIC_RELEASE);
+}
+
+static void arm_accept(event_loop_t* loop) {
+    struct io_uring_sqe* sqe = get_sqe(loop->uring);
+    if (!sqe) {
+        return;
+    }
+
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = loop->listen_fd;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->user_data = make_user_data(NULL, URING_OP_ACCEPT);
+    queue_sqe(loop->uring);
+}
+
+static void arm_poll(event_loop_t* loop, int fd, unsigned events, unsigned op, void* ptr, bool multishot) {
+    struct io_uring_sqe* sqe = get_sqe(loop->uring);
+    if (!sqe) {
+        return;
+    }
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = events;
+    sqe->len = multishot ? IORING_POLL_ADD_MULTI : 0;
+    sqe->user_data = make_user_data(ptr, op);
+    queue_sqe(loop->uring);
+}
+
+static void submit_recv(event_loop_t* loop, connection_t* conn) {
+    if (conn->buffer_len >= conn->buffer_cap - 1 && !grow_connection_buffer(conn)) {
+        close_connection(loop, conn);
+        return;
+    }
+
+    struct io_uring_sqe* sqe = get_sqe(loop->uring);
+    if (!sqe) {
+        close_connection(loop, conn);
+        return;
+    }
+
+    size_t space = conn->buffer_cap - 1 - conn->buffer_len;
+
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = conn->fd;
+    sqe->len = space < URING_BUFFER_SIZE ? space : URING_BUFFER_SIZE;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = URING_BUFFER_GROUP;
+    sqe->user_data = make_user_data(conn, URING_OP_RECV);
+    queue_sqe(loop->uring);
+    conn->pending_ops++;
+}
+
+void uring_submit_send(event_loop_t* loop, connection_t* conn) {
+    struct io_uring_sqe* sqe = get_sqe(loop->uring);
+    if (!sqe) {
+        close_connection(loop, conn);
+        return;
+    }
+
+    memset(&conn->send_msg, 0, sizeof(conn->send_msg));
+    conn->send_msg.msg_iov = conn->send_iov;
+    conn->send_msg.msg_iovlen = http_response_pending_iov(&conn->response, conn->response_sent, conn->send_iov);
+
+    sqe->opcode = IORING_OP_SENDMSG;
+    sqe->fd = conn->fd;
+    sqe->addr = (uint64_t)(uintptr_t)&conn->send_msg;
+    sqe->len = 1;
+    sqe->msg_flags = MSG_NOSIGNAL | (conn->response.file_length ? MSG_MORE : 0);
+    sqe->user_data = make_user_data(conn, URING_OP_SEND);
+    queue_sqe(loop->uring);
+    conn->pending_ops++;
+}
+
+void uring_watch_websocket(event_loop_t* loop, connection_t* conn) {
+    arm_poll(loop, conn->fd, POLLIN, URING_OP_WS_POLL, conn, false);
+    conn->pending_ops++;
+}
+
+static bool settle_closed(connection_t* conn) {
+    if (!conn->closed) {
+        return false;
+    }
+    if (conn->pending_ops == 0) {
+        release_connection(conn);
+    }
+    return true;
+}
+
+static void handle_recv(event_loop_t* loop, connection_t* conn, const struct io_uring_cqe* cqe) {
+    struct uring_backend* ring = loop->uring;
+    bool has_buffer = (cqe->flags & IORING_CQE_F_BUFFER) != 0;
+    unsigned short bid = (unsigned short)(cqe->flags >> IORING_CQE_BUFFER_SHIFT);
+
+    conn->pending_ops--;
+    if (conn->closed) {
+        if (has_buffer) {
+            recycle_buffer(ring, bid);
+        }
+        settle_closed(conn);
+        return;
+    }
+
+    if (cqe->res == -ENOBUFS || cqe->res == -EINTR || cqe->res == -EAGAIN) {
+        submit_recv(loop, conn);
+        return;
+    }
+
+    if (cqe->res <= 0 || !has_buffer) {
+        if (has_buffer) {
+            recycle_buffer(ring, bid);
+        }
+        close_connection(loop, conn);
+        return;
+    }
+
+    memcpy(conn->buffer + conn->buffer_len, ring->buffers + (size_t)bid * URING_BUFFER_SIZE, cqe->res);
+    recycle_buffer(ring, bid);
+    conn->buffer_len += cqe->res;
+    conn->buffer[conn->buffer_len] = '\0';
+
+    if (connection_data_received(loop, conn)) {
+        submit_recv(loop, conn);
+    }
+}
+
+static void finish_send(event_loop_t* loop, connection_t* conn) {
+    if (complete_response(loop, conn) && connection_data_received(loop, conn)) {
+        submit_recv(loop, conn);
+    }
+}
+
+// io_uring has no sendfile opcode, so wait for POLLOUT and call it directly
+static void send_file_segment(event_loop_t* loop, connection_t* conn) {
+    while (conn->response_sent < conn->response.length) {
+        ssize_t sent = http_response_send_file(&conn->response, conn->fd, conn->response_sent);
+        if (sent > 0) {
+            conn->response_sent += sent;
+            continue;
+        }
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            arm_poll(loop, conn->fd, POLLOUT, URING_OP_FILE_POLL, conn, false);
+            conn->pending_ops++;
+            return;
+        }
+        close_connection(loop, conn);
+        return;
+    }
+    finish_send(loop, conn);
+}
+
+static void handle_send(event_loop_t* loop, connection_t* conn, const struct io_uring_cqe* cqe) {
+    conn->pending_ops--;
+    if (settle_closed(conn)) {
+        return;
+    }
+
+    if (cqe->res == -EINTR || cqe->res == -EAGAIN) {
+        uring_submit_send(loop, conn);
+        return;
+    }
+
+    if (cqe->res <= 0) {
+        close_connection(loop, conn);
+        return;
+    }
+
+    conn->response_sent += cqe->res;
+    if (conn->response_sent >= conn->response.length) {
+        finish_send(loop, conn);
+    } else if (conn->response_sent >= conn->response.length - conn->response.file_length) {
+        send_file_segment(loop, conn);
+    } else {
+        set_connection_cork(conn, true);
+        uring_submit_send(loop, conn);
+    }
+}
+
+static void handle_file_poll(event_loop_t* loop, connection_t* conn, const struct io_uring_cqe* cqe) {
+    conn->pending_ops--;
+    if (settle_closed(conn)) {
+        return;
+    }
+
+    if (cqe->res < 0) {
+        close_connection(loop, conn);
+        return;
+    }
+    send_file_segment(loop, conn);
+}
+
+static void handle_websocket_poll(event_loop_t* loop, connection_t* conn, const struct io_uring_cqe* cqe) {
+    conn->pending_ops--;
+    if (settle_closed(conn)) {
+        return;
+    }
+
+    if (cqe->res < 0) {
+        close_connection(loop, conn);
+        return;
+    }
+
+    if (handle_websocket_readable(loop, conn)) {
+        uring_watch_websocket(loop, conn);
+    }
+}
+
+static void handle_cqe(event_loop_t* loop, const struct io_uring_cqe* cqe) {
+    unsigned op = (unsigned)(cqe->user_data & URING_OP_MASK);
+    connection_t* conn = (connection_t*)(uintptr_t)(cqe->user_data & ~URING_OP_MASK);
+    bool more = (cqe->flags & IORING_CQE_F_MORE) != 0;
+
+    switch (op) {
+        case URING_OP_ACCEPT:
+            if (cqe->res >= 0) {
+                connection_t* accepted = register_connection(loop, cqe->res, NULL);
+                if (accepted && !refuse_rate_limited(loop, accepted)) {
+                    submit_recv(loop, accepted);
+                }
+            } else if (cqe->res != -EAGAIN && cqe->res != -EINTR && cqe->res != -ECONNABORTED &&
+                       cqe->res != -ECANCELED) {
+                fprintf(stderr, "%s%s[ERROR] %sConnection not accepted: %s%s\n",
+                        BOLD, COLOR_RED, COLOR_RESET, strerror(-cqe->res), COLOR_RESET);
+            }
+            if (!more && !loop->draining) {
+                arm_accept(loop);
+            }
+            break;
+        case URING_OP_RECV:
+            handle_recv(loop, conn, cqe);
+            break;
+        case URING_OP_SEND:
+            handle_send(loop, conn, cqe);
+            break;
+        case URING_OP_WS_POLL:
+            handle_websocket_poll(loop, conn, cqe);
+            break;
+        case URING_OP_FILE_POLL:
+            handle_file_poll(loop, conn, cqe);
+            break;
+        case URING_OP_NOTIFY:
+            drain_completions(loop);
+            if (!more) {
+                arm_poll(loop, loop->notify_fd, POLLIN, URING_OP_NOTIFY, NULL, true);
+            }
+            break;
+        case URING_OP_WATCH:
+            handle_file_events(loop);
+            if (!more) {
+                arm_poll(loop, loop->watch_fd, POLLIN, URING_OP_WATCH, NULL, true);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+int init_uring_backend(event_loop_t* loop) {
+    struct uring_backend* ring = calloc(1, sizeof(struct uring_backend));
+    if (!ring) {
+        return -1;
+    }
+
+    ring->ring_fd = -1;
+    ring->ring_ptr = MAP_FAILED;
+    ring->sqes = MAP_FAILED;
+    ring->buf_ring = MAP_FAILED;
+    loop->uring = ring;
+
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    ring->ring_fd = uring_setup(URING_ENTRIES, &params);
+    if (ring->ring_fd < 0) {
+        printf("%s%s[IO_URING] %sUnavailable (%s), falling back to epoll%s\n",
+               BOLD, COLOR_YELLOW, COLOR_RESET, strerror(errno), COLOR_RESET);
+        free_uring_backend(loop);
+        return -1;
+    }
+
+    if (!(params.features & IORING_FEAT_SINGLE_MMAP) || !(params.features & IORING_FEAT_EXT_ARG)) {
+        printf("%s%s[IO_URING] %sKernel too old, falling back to epoll%s\n",
+               BOLD, COLOR_YELLOW, COLOR_RESET, COLOR_RESET);
+        free_uring_backend(loop);
+        return -1;
+    }
+
+    size_t sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    size_t cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_size = sq_size > cq_size ? sq_size : cq_size;
+    ring->ring_ptr = mmap(NULL, ring->ring_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQ_RING);
+    ring->sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE,
+                      MAP_SHARED | MAP_POPULATE, ring->ring_fd, IORING_OFF_SQES);
+    if (ring->ring_ptr == MAP_FAILED || ring->sqes == MAP_FAILED) {
+        fprintf(stderr, "%s%s[IO_URING] %sFailed to map rings: %s%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+        free_uring_backend(loop);
+        return -1;
+    }
+
+    char* base = ring->ring_ptr;
+    ring->sq_entries = params.sq_entries;
+    ring->sq_head = (unsigned*)(base + params.sq_off.head);
+    ring->sq_tail = (unsigned*)(base + params.sq_off.tail);
+    ring->sq_mask = (unsigned*)(base + params.sq_off.ring_mask);
+    ring->sq_array = (unsigned*)(base + params.sq_off.array);
+    ring->cq_head = (unsigned*)(base + params.cq_off.head);
+    ring->cq_tail = (unsigned*)(base + params.cq_off.tail);
+    ring->cq_mask = (unsigned*)(base + params.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(base + params.cq_off.cqes);
+
+    ring->buf_ring_size = URING_BUFFER_COUNT * sizeof(struct io_uring_buf);
+    ring->buf_ring = mmap(NULL, ring->buf_ring_size, PROT_READ | PROT_WRITE,
+                          MAP_ANONYMOUS | MAP_PRIVATE, -1, 0);
+    ring->buffers = malloc((size_t)URING_BUFFER_COUNT * URING_BUFFER_SIZE);
+    if (ring->buf_ring == MAP_FAILED || !ring->buffers) {
+        fprintf(stderr, "%s%s[IO_URING] %sFailed to allocate receive buffers%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+        free_uring_backend(loop);
+        return -1;
+    }
+
+    struct io_uring_buf_reg reg;
+    memset(&reg, 0, sizeof(reg));
+    reg.ring_addr = (uint64_t)(uintptr_t)ring->buf_ring;
+    reg.ring_entries = URING_BUFFER_COUNT;
+    reg.bgid = URING_BUFFER_GROUP;
+    if (uring_register(ring->ring_fd, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        printf("%s%s[IO_URING] %sProvided buffer rings unsupported (%s), falling back to epoll%s\n",
+               BOLD, COLOR_YELLOW, COLOR_RESET, strerror(errno), COLOR_RESET);
+        free_uring_backend(loop);
+        return -1;
+    }
+
+    ring->buf_ring->tail = 0;
+    for (unsigned short bid = 0; bid < URING_BUFFER_COUNT; bid++) {
+        recycle_buffer(ring, bid);
+    }
+
+    printf("%s%s[IO_URING] %sBackend enabled (%u entries, %d provided buffers)%s\n",
+           BOLD, COLOR_BLUE, COLOR_GREEN, params.sq_entries, URING_BUFFER_COUNT, COLOR_RESET);
+    return 0;
+}
+
+void uring_stop_accept(event_loop_t* loop) {
+    struct io_uring_sqe* sqe = get_sqe(loop->uring);
+    if (!sqe) {
+        return;
+    }
+
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->addr = make_user_data(NULL, URING_OP_ACCEPT);
+    sqe->user_data = make_user_data(NULL, URING_OP_CANCEL);
+    queue_sqe(loop->uring);
+}
+
+void run_uring_loop(event_loop_t* loop, volatile sig_atomic_t* running, volatile sig_atomic_t* draining) {
+    struct uring_backend* ring = loop->uring;
+
+    arm_accept(loop);
+    arm_poll(loop, loop->notify_fd, POLLIN, URING_OP_NOTIFY, NULL, true);
+    if (loop->watch_fd >= 0) {
+        arm_poll(loop, loop->watch_fd, POLLIN, URING_OP_WATCH, NULL, true);
+    }
+
+    while (*running && !check_drain(loop, *draining)) {
+        if (flush_submissions(ring, next_timer_timeout(loop)) < 0 && errno != ETIME) {
+            if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+                continue;
+            }
+            fprintf(stderr, "%s%s[ERROR] %sio_uring_enter error: %s%s\n",
+                    BOLD, COLOR_RED, COLOR_RESET, strerror(errno), COLOR_RESET);
+            break;
+        }
+
+        unsigned head = *ring->cq_head;
+        for (;;) {
+            unsigned tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+            if (head == tail) {
+                break;
+            }
+
+            struct io_uring_cqe cqe = ring->cqes[head & *ring->cq_mask];
+            head++;
+            __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+            handle_cqe(loop, &cqe);
+        }
+
+        run_timers(loop);
+    }
+}
+
+void free_uring_backend(event_loop_t* loop) {
+    struct uring_backend* ring = loop->uring;
+    if (!ring) {
+        return;
+    }
+
+    if (ring->ring_fd >= 0) {
+        close(ring->ring_fd);
+    }
+    if (ring->ring_ptr != MAP_FAILED) {
+        munmap(ring->ring_ptr, ring->ring_size);
+    }
+    if (ring->sqes != MAP_FAILED) {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (ring->buf_ring != MAP_FAILED) {
+        munmap(ring->buf_ring, ring->buf_ring_size);
+    }
+    free(ring->buffers);
+    free(ring);
+    loop->uring = NULL;
+}
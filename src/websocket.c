@@ -1,11 +1,11 @@
 #include "websocket.h"
+#include "debug.h"
 #include <openssl/sha.h>
 #include <openssl/bio.h>
 #include <openssl/evp.h>
 #include <openssl/buffer.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <sys/select.h>
 #include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <endian.h>
@@ -13,10 +13,8 @@
 
 static char* base64_encode(const unsigned char* input, int length);
 static int make_socket_non_blocking(int socket_fd);
-static void cleanup_ws_client(ws_clients_t* clients, int client_socket);
 static char* create_ws_frame(const char* message, size_t length, int opcode, size_t* frame_size);
 static void dump_client_list(ws_clients_t* clients);
-int is_websocket_request(const char* buffer); 
 
 #ifndef ntohll
 #if __BYTE_ORDER == __LITTLE_ENDIAN
@@ -68,6 +66,8 @@ ws_clients_t* init_ws_clients() {
     } 
     
     memset(clients->client_sockets, 0, sizeof(clients->client_sockets));
+    memset(clients->client_keys, 0, sizeof(clients->client_keys));
+    memset(clients->client_names, 0, sizeof(clients->client_names));
     clients->count = 0;
     
     if (pthread_mutex_init(&clients->mutex, NULL) != 0) {
@@ -99,11 +99,11 @@ static int make_socket_non_blocking(int socket_fd) {
     return 0;
 }
 
-void add_ws_client(ws_clients_t* clients, int socket_fd) {
+int add_ws_client(ws_clients_t* clients, int socket_fd) {
     if (!clients || socket_fd <= 0) {
-        printf("%s%s[WebSocket] %sInvalid arguments to add_ws_client%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
-        return;
+        REQUEST_LOG("%s%s[WebSocket] %sInvalid arguments to add_ws_client%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+        return -1;
     }
     
     if (make_socket_non_blocking(socket_fd) < 0) {
@@ -113,50 +113,43 @@ void add_ws_client(ws_clients_t* clients, int socket_fd) {
     
     char client_info[64] = "unknown";
     char client_ip[INET_ADDRSTRLEN] = {0};
-    int client_port = 0;
+    uint64_t client_key = 0;
     struct sockaddr_in addr;
     socklen_t addr_len = sizeof(addr);
-    if (getpeername(socket_fd, (struct sockaddr *)&addr, &addr_len) == 0) {
+    if (getpeername(socket_fd, (struct sockaddr *)&addr, &addr_len) == 0 && addr.sin_family == AF_INET) {
         inet_ntop(AF_INET, &(addr.sin_addr), client_ip, INET_ADDRSTRLEN);
-        client_port = ntohs(addr.sin_port);
-        snprintf(client_info, sizeof(client_info), "%s:%d", client_ip, client_port);
+        snprintf(client_info, sizeof(client_info), "%s:%d", client_ip, ntohs(addr.sin_port));
+        client_key = peer_address_key((struct sockaddr *)&addr);
     }
     
     pthread_mutex_lock(&clients->mutex);
     
-    if (client_ip[0] != '\0') {
+    if (client_key != 0) {
         for (int i = 0; i < MAX_CLIENTS; i++) {
-            if (clients->client_sockets[i] != 0 && clients->client_sockets[i] != socket_fd) {
-                struct sockaddr_in existing_addr;
-                socklen_t existing_len = sizeof(existing_addr);
-                char existing_ip[INET_ADDRSTRLEN] = {0};
+            if (clients->client_sockets[i] != 0 && clients->client_sockets[i] != socket_fd &&
+                clients->client_keys[i] == client_key) {
+                int old_socket = clients->client_sockets[i];
+                REQUEST_LOG("%s%s[WebSocket] %sReplacing existing connection from %s (socket %d → %d)%s\n", 
+                            BOLD, COLOR_BLUE, COLOR_YELLOW, client_ip, old_socket, socket_fd, COLOR_RESET);
                 
-                if (getpeername(clients->client_sockets[i], (struct sockaddr *)&existing_addr, &existing_len) == 0) {
-                    inet_ntop(AF_INET, &(existing_addr.sin_addr), existing_ip, INET_ADDRSTRLEN);
-                    if (strcmp(client_ip, existing_ip) == 0) {
-                        int old_socket = clients->client_sockets[i];
-                        printf("%s%s[WebSocket] %sReplacing existing connection from %s (socket %d → %d)%s\n", 
-                               BOLD, COLOR_BLUE, COLOR_YELLOW, existing_ip, old_socket, socket_fd, COLOR_RESET);
-                        
-                        close(old_socket);
-                        clients->client_sockets[i] = socket_fd;
-                        pthread_mutex_unlock(&clients->mutex);
-                        printf("%s%s[WebSocket] %sClient reconnected, total clients: %s%d%s\n", 
-                               BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, clients->count, COLOR_RESET);
-                        dump_client_list(clients);
-                        return;
-                    }
-                }
+                shutdown(old_socket, SHUT_RDWR);
+                clients->client_sockets[i] = socket_fd;
+                snprintf(clients->client_names[i], sizeof(clients->client_names[i]), "%s", client_info);
+                pthread_mutex_unlock(&clients->mutex);
+                REQUEST_LOG("%s%s[WebSocket] %sClient reconnected, total clients: %s%d%s\n", 
+                            BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, clients->count, COLOR_RESET);
+                dump_client_list(clients);
+                return 0;
             }
         }
     }
     
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (clients->client_sockets[i] == socket_fd) {
-            printf("%s%s[WebSocket] %sClient already exists, socket: %d (%s)%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_YELLOW, socket_fd, client_info, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %sClient already exists, socket: %d (%s)%s\n", 
+                        BOLD, COLOR_BLUE, COLOR_YELLOW, socket_fd, client_info, COLOR_RESET);
             pthread_mutex_unlock(&clients->mutex);
-            return;
+            return 0;
         }
     }
     
@@ -165,11 +158,13 @@ void add_ws_client(ws_clients_t* clients, int socket_fd) {
         for (int i = 0; i < MAX_CLIENTS; i++) {
             if (clients->client_sockets[i] == 0) {
                 clients->client_sockets[i] = socket_fd;
+                clients->client_keys[i] = client_key;
+                snprintf(clients->client_names[i], sizeof(clients->client_names[i]), "%s", client_info);
                 clients->count++;
                 added = 1;
-                printf("%s%s[WebSocket] %sClient added, socket: %d (%s%s%s), total clients: %s%d%s\n", 
-                       BOLD, COLOR_BLUE, COLOR_GREEN, socket_fd, COLOR_CYAN, client_info, COLOR_GREEN, 
-                       COLOR_YELLOW, clients->count, COLOR_RESET);
+                REQUEST_LOG("%s%s[WebSocket] %sClient added, socket: %d (%s%s%s), total clients: %s%d%s\n", 
+                            BOLD, COLOR_BLUE, COLOR_GREEN, socket_fd, COLOR_CYAN, client_info, COLOR_GREEN, 
+                            COLOR_YELLOW, clients->count, COLOR_RESET);
                 break;
             }
         }
@@ -178,11 +173,13 @@ void add_ws_client(ws_clients_t* clients, int socket_fd) {
     if (!added) {
         fprintf(stderr, "%s%s[WebSocket] %sMaximum clients reached (%d), cannot add more%s\n", 
                 BOLD, COLOR_RED, COLOR_RESET, MAX_CLIENTS, COLOR_RESET);
-        close(socket_fd);
+        pthread_mutex_unlock(&clients->mutex);
+        return -1;
     }
     
     pthread_mutex_unlock(&clients->mutex);
     dump_client_list(clients);
+    return 0;
 }
 
 static void dump_client_list(ws_clients_t* clients) {
@@ -190,29 +187,21 @@ static void dump_client_list(ws_clients_t* clients) {
     
     pthread_mutex_lock(&clients->mutex);
     
-    printf("%s%s[WebSocket] %sCurrent clients (%d total):%s\n", 
-           BOLD, COLOR_BLUE, COLOR_RESET, clients->count, COLOR_RESET);
+    REQUEST_LOG("%s%s[WebSocket] %sCurrent clients (%d total):%s\n", 
+                BOLD, COLOR_BLUE, COLOR_RESET, clients->count, COLOR_RESET);
     
     int active_count = 0;
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (clients->client_sockets[i] != 0) {
-            char client_desc[64] = "unknown";
-            struct sockaddr_in caddr;
-            socklen_t caddr_len = sizeof(caddr);
-            if (getpeername(clients->client_sockets[i], (struct sockaddr *)&caddr, &caddr_len) == 0) {
-                char ip[INET_ADDRSTRLEN];
-                inet_ntop(AF_INET, &(caddr.sin_addr), ip, INET_ADDRSTRLEN);
-                snprintf(client_desc, sizeof(client_desc), "%s:%d", ip, ntohs(caddr.sin_port));
-            }
-            printf("  %s[%d]%s Socket %s%d%s: %s%s%s\n", 
-                   COLOR_YELLOW, i, COLOR_RESET, COLOR_CYAN, clients->client_sockets[i], 
-                   COLOR_RESET, COLOR_GREEN, client_desc, COLOR_RESET);
+            REQUEST_LOG("  %s[%d]%s Socket %s%d%s: %s%s%s\n", 
+                        COLOR_YELLOW, i, COLOR_RESET, COLOR_CYAN, clients->client_sockets[i], 
+                        COLOR_RESET, COLOR_GREEN, clients->client_names[i], COLOR_RESET);
             active_count++;
         }
     }
     
     if (active_count == 0) {
-        printf("  %sNo active clients%s\n", COLOR_YELLOW, COLOR_RESET);
+        REQUEST_LOG("  %sNo active clients%s\n", COLOR_YELLOW, COLOR_RESET);
     }
     
     pthread_mutex_unlock(&clients->mutex);
@@ -223,99 +212,67 @@ void remove_ws_client(ws_clients_t* clients, int socket_fd) {
     
     pthread_mutex_lock(&clients->mutex);
     
-    int removed = 0;
     for (int i = 0; i < MAX_CLIENTS; i++) {
         if (clients->client_sockets[i] == socket_fd) {
             clients->client_sockets[i] = 0;
             clients->count--;
-            removed = 1;
-            printf("%s%s[WebSocket] %sClient removed, socket: %s%d%s, total clients: %s%d%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, socket_fd, COLOR_YELLOW, 
-                   COLOR_GREEN, clients->count, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %sClient removed, socket: %s%d%s, total clients: %s%d%s\n", 
+                        BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, socket_fd, COLOR_YELLOW, 
+                        COLOR_GREEN, clients->count, COLOR_RESET);
             break;
         }
     }
     
     pthread_mutex_unlock(&clients->mutex);
-    if (removed) {
-        close(socket_fd);
-    }
 }
 
 bool is_client_connected(int socket_fd) {
     if (socket_fd <= 0) return false;
-    fd_set read_fds;
-    struct timeval tv = {0, 0};
-    
-    FD_ZERO(&read_fds);
-    FD_SET(socket_fd, &read_fds);
-    
-    int result = select(socket_fd + 1, &read_fds, NULL, NULL, &tv);
-    
-    if (result < 0) {
+    char buffer[1];
+    ssize_t result = recv(socket_fd, buffer, 1, MSG_PEEK | MSG_DONTWAIT);
+    if (result == 0) {
         return false;
-    } else if (result > 0) {
-        char buffer[1];
-        result = recv(socket_fd, buffer, 1, MSG_PEEK | MSG_DONTWAIT);       
-        if (result == 0) {
-            return false;
-        } else if (result < 0) {
-            if (errno == EAGAIN || errno == EWOULDBLOCK) {
-                return true;
-            }
-            return false;
-        }
-        return true;
-    }   
-    return true; 
+    } else if (result < 0) {
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+    return true;
 }
 
-int process_ws_handshake(int client_socket, char* buffer) {
-    if (client_socket <= 0 || !buffer) return -1;
+int process_ws_handshake(int client_socket, const http_request_t* request) {
+    if (client_socket <= 0 || !request) return -1;
     
-    printf("%s%s[WebSocket] %sProcessing handshake for client %s%d%s\n", 
-           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, client_socket, COLOR_RESET);
+    REQUEST_LOG("%s%s[WebSocket] %sProcessing handshake for client %s%d%s\n", 
+                BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, client_socket, COLOR_RESET);
 
-    if (!strstr(buffer, "Upgrade: websocket")) {
-        printf("%s%s[WebSocket] %sHandshake failed: %s'Upgrade: websocket' header missing%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    if (!http_header_has_token(request, "Upgrade", "websocket")) {
+        REQUEST_LOG("%s%s[WebSocket] %sHandshake failed: %s'Upgrade: websocket' header missing%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
         return -1;
     }
     
 
-    if (!strstr(buffer, "Connection: Upgrade")) {
-        printf("%s%s[WebSocket] %sHandshake failed: %s'Connection: Upgrade' header missing%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    if (!http_header_has_token(request, "Connection", "Upgrade")) {
+        REQUEST_LOG("%s%s[WebSocket] %sHandshake failed: %s'Connection: Upgrade' header missing%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
         return -1;
     }
     
 
-    char* key_start = strstr(buffer, "Sec-WebSocket-Key: ");
-    if (!key_start) {
-        printf("%s%s[WebSocket] %sHandshake failed: %s'Sec-WebSocket-Key' header missing%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
-        return -1;
-    }
-    
-    key_start += 19;
-    char* key_end = strstr(key_start, "\r\n");
-    if (!key_end) {
-        printf("%s%s[WebSocket] %sHandshake failed: %sInvalid 'Sec-WebSocket-Key' format%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    const http_slice_t* key = find_http_header(request, "Sec-WebSocket-Key");
+    if (!key || key->len == 0) {
+        REQUEST_LOG("%s%s[WebSocket] %sHandshake failed: %s'Sec-WebSocket-Key' header missing%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
         return -1;
     }
     
-    size_t key_length = key_end - key_start;
-    if (key_length >= 256) {
-        printf("%s%s[WebSocket] %sHandshake failed: %s'Sec-WebSocket-Key' too long%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+    char ws_key[256] = {0};
+    if (http_slice_copy(*key, ws_key, sizeof(ws_key)) < 0) {
+        REQUEST_LOG("%s%s[WebSocket] %sHandshake failed: %s'Sec-WebSocket-Key' too long%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
         return -1;
     }
-    
-    char ws_key[256] = {0};
-    strncpy(ws_key, key_start, key_length);
-    printf("%s%s[WebSocket] %sKey: %s%s%s\n", 
-           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, ws_key, COLOR_RESET);
+    REQUEST_LOG("%s%s[WebSocket] %sKey: %s%s%s\n", 
+                BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, ws_key, COLOR_RESET);
     
     char combined_key[512] = {0};
     sprintf(combined_key, "%s%s", ws_key, WS_HANDSHAKE_KEY);
@@ -325,13 +282,13 @@ int process_ws_handshake(int client_socket, char* buffer) {
     
     char* encoded_hash = base64_encode(hash, SHA_DIGEST_LENGTH);
     if (!encoded_hash) {
-        printf("%s%s[WebSocket] %sHandshake failed: %sBase64 encoding failed%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
+        REQUEST_LOG("%s%s[WebSocket] %sHandshake failed: %sBase64 encoding failed%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, COLOR_RESET);
         return -1;
     }
     
-    printf("%s%s[WebSocket] %sAccept key: %s%s%s\n", 
-           BOLD, COLOR_BLUE, COLOR_RESET, COLOR_MAGENTA, encoded_hash, COLOR_RESET);
+    REQUEST_LOG("%s%s[WebSocket] %sAccept key: %s%s%s\n", 
+                BOLD, COLOR_BLUE, COLOR_RESET, COLOR_MAGENTA, encoded_hash, COLOR_RESET);
     
     // Construct the response
     char response[512];
@@ -342,20 +299,16 @@ int process_ws_handshake(int client_socket, char* buffer) {
              "Sec-WebSocket-Accept: %s\r\n"
              "\r\n", encoded_hash);
     
-    struct timeval tv;
-    tv.tv_sec = 5; 
-    tv.tv_usec = 0;
-    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof tv);
     ssize_t bytes_sent = send(client_socket, response, strlen(response), 0);  
     free(encoded_hash);  
     if (bytes_sent <= 0) {
-        printf("%s%s[WebSocket] %sHandshake failed: %sFailed to send response (%s)%s\n", 
-               BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, strerror(errno), COLOR_RESET);
+        REQUEST_LOG("%s%s[WebSocket] %sHandshake failed: %sFailed to send response (%s)%s\n", 
+                    BOLD, COLOR_RED, COLOR_RESET, COLOR_YELLOW, strerror(errno), COLOR_RESET);
         return -1;
     }
     
-    printf("%s%s[WebSocket] %s%sHandshake successful%s, sent %s%zd%s bytes\n", 
-           BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET, COLOR_YELLOW, bytes_sent, COLOR_RESET);
+    REQUEST_LOG("%s%s[WebSocket] %s%sHandshake successful%s, sent %s%zd%s bytes\n", 
+                BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET, COLOR_YELLOW, bytes_sent, COLOR_RESET);
     return 0;
 }
 
@@ -405,10 +358,6 @@ int send_ws_frame(int client_socket, const char* message, size_t length, int opc
         return -1;
     }
     
-    struct timeval tv;
-    tv.tv_sec = 1;
-    tv.tv_usec = 0;
-    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof tv);
     size_t total_sent = 0;
     while (total_sent < frame_size) {
         ssize_t bytes_sent = send(client_socket, frame + total_sent, frame_size - total_sent, 0);
@@ -416,7 +365,7 @@ int send_ws_frame(int client_socket, const char* message, size_t length, int opc
         if (bytes_sent <= 0) {
             if (errno != EPIPE && errno != ECONNRESET && 
                 errno != EAGAIN && errno != EWOULDBLOCK && errno != ETIMEDOUT) {
-                printf("Socket %d send error: %s\n", client_socket, strerror(errno));
+                REQUEST_LOG("Socket %d send error: %s\n", client_socket, strerror(errno));
             }
             free(frame);
             return -1;
@@ -429,16 +378,6 @@ int send_ws_frame(int client_socket, const char* message, size_t length, int opc
     return 0;
 }
 
-static void cleanup_ws_client(ws_clients_t* clients, int client_socket) {
-    if (!clients || client_socket <= 0) return;
-    remove_ws_client(clients, client_socket);
-    char close_frame[2] = {0x88, 0x00};
-    struct timeval tv = {0, 100000};
-    setsockopt(client_socket, SOL_SOCKET, SO_SNDTIMEO, (const char*)&tv, sizeof tv);
-    send(client_socket, close_frame, 2, 0);
-    close(client_socket);
-}
-
 void broadcast_to_ws_clients(ws_clients_t* clients, const char* message) {
     if (!clients || !message) return;
     bool is_ping = (strcmp(message, "ping") == 0);
@@ -450,9 +389,9 @@ void broadcast_to_ws_clients(ws_clients_t* clients, const char* message) {
                 int socket_to_close = clients->client_sockets[i];
                 clients->client_sockets[i] = 0;
                 clients->count--;
-                printf("%s%s[WebSocket] %sClient %s%d%s disconnected, removing\n", 
-                       BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, socket_to_close, COLOR_RESET);
-                close(socket_to_close);
+                REQUEST_LOG("%s%s[WebSocket] %sClient %s%d%s disconnected, removing\n", 
+                            BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, socket_to_close, COLOR_RESET);
+                shutdown(socket_to_close, SHUT_RDWR);
             }
         }
     }
@@ -465,14 +404,14 @@ void broadcast_to_ws_clients(ws_clients_t* clients, const char* message) {
             int result = send_ws_frame(clients->client_sockets[i], message, strlen(message), WS_TEXT);
             if (result < 0) {
                 if (!is_ping) {
-                    printf("%s%s[WebSocket] %sFailed to send to client %s%d%s, removing\n", 
-                           BOLD, COLOR_RED, COLOR_RESET, COLOR_CYAN, clients->client_sockets[i], COLOR_RESET);
+                    REQUEST_LOG("%s%s[WebSocket] %sFailed to send to client %s%d%s, removing\n", 
+                                BOLD, COLOR_RED, COLOR_RESET, COLOR_CYAN, clients->client_sockets[i], COLOR_RESET);
                 }
                 
                 int socket_to_close = clients->client_sockets[i];
                 clients->client_sockets[i] = 0;
                 clients->count--;
-                close(socket_to_close);
+                shutdown(socket_to_close, SHUT_RDWR);
                 send_failures++;
             } else {
                 send_success++;
@@ -481,142 +420,54 @@ void broadcast_to_ws_clients(ws_clients_t* clients, const char* message) {
     }
     
     if (!is_ping && (send_success > 0 || send_failures > 0)) {
-        printf("%s%s[WebSocket] %sBroadcast '%s%s%s': %s%d%s successful, %s%d%s failed, %s%d%s total clients\n", 
-               BOLD, COLOR_BLUE, COLOR_RESET, COLOR_GREEN, message, COLOR_RESET, 
-               COLOR_GREEN, send_success, COLOR_RESET, 
-               COLOR_RED, send_failures, COLOR_RESET, 
-               COLOR_YELLOW, clients->count, COLOR_RESET);
+        REQUEST_LOG("%s%s[WebSocket] %sBroadcast '%s%s%s': %s%d%s successful, %s%d%s failed, %s%d%s total clients\n", 
+                    BOLD, COLOR_BLUE, COLOR_RESET, COLOR_GREEN, message, COLOR_RESET, 
+                    COLOR_GREEN, send_success, COLOR_RESET, 
+                    COLOR_RED, send_failures, COLOR_RESET, 
+                    COLOR_YELLOW, clients->count, COLOR_RESET);
     }
     
     pthread_mutex_unlock(&clients->mutex);
 }
 
-void handle_ws_connection(int client_socket, ws_clients_t* clients) {
-    if (client_socket <= 0 || !clients) {
-        if (client_socket > 0) close(client_socket);
-        return;
-    }
-    
-    struct timeval tv;
-    tv.tv_sec = 5; 
-    tv.tv_usec = 0;
-    if (setsockopt(client_socket, SOL_SOCKET, SO_RCVTIMEO, (const char*)&tv, sizeof tv) < 0) {
-        perror("setsockopt failed on WebSocket client socket");
-        close(client_socket);
-        return;
-    }
-    
-    int yes = 1;
-    if (setsockopt(client_socket, SOL_SOCKET, SO_KEEPALIVE, &yes, sizeof(int)) < 0) {
-        perror("Failed to set SO_KEEPALIVE on WebSocket socket");
-    }
-    
-    char buffer[BUFFER_SIZE] = {0};
-    ssize_t bytes_read = recv(client_socket, buffer, BUFFER_SIZE - 1, 0);
-    if (bytes_read <= 0) {
-        perror("Error reading from WebSocket client");
-        close(client_socket);
-        return;
-    }
-    buffer[bytes_read] = '\0';
-    char client_info[50] = "unknown";
-    struct sockaddr_in addr;
-    socklen_t addr_len = sizeof(addr);
-    
-    if (getpeername(client_socket, (struct sockaddr *)&addr, &addr_len) == 0) {
-        snprintf(client_info, sizeof(client_info), "%s:%d", 
-                inet_ntoa(addr.sin_addr), ntohs(addr.sin_port));
-        printf("%s%s[WebSocket] %sConnection attempt from %s%s%s\n", 
-               BOLD, COLOR_BLUE, COLOR_RESET, COLOR_CYAN, client_info, COLOR_RESET);
-    }
-    
-    if (is_websocket_request(buffer)) {
-        printf("%s%s[WebSocket] %s%sValid handshake%s received from %s%s%s\n", 
-               BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET, 
-               COLOR_CYAN, client_info, COLOR_RESET);
-        
-        if (process_ws_handshake(client_socket, buffer) == 0) {
-            printf("%s%s[WebSocket] %s%sHandshake successful%s with %s%s%s, adding to clients\n", 
-                   BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET, 
-                   COLOR_CYAN, client_info, COLOR_RESET);
-            add_ws_client(clients, client_socket);
-            printf("%s%s[WebSocket] %s%sHandshake successful%s\n", 
-                   BOLD, COLOR_BLUE, BOLD, COLOR_GREEN, COLOR_RESET);
-
-            if (send_ws_frame(client_socket, "ping", 4, WS_TEXT) == 0) {
-                printf("%s%s[WebSocket] %sInitial ping sent to %s%s%s\n", 
-                       BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, client_info, COLOR_RESET);
-            } else {
-                printf("%s%s[WebSocket] %s%sFailed to send initial ping%s to %s%s%s\n", 
-                       BOLD, COLOR_BLUE, BOLD, COLOR_RED, COLOR_RESET, 
-                       COLOR_CYAN, client_info, COLOR_RESET);
-            }
-            return;
-        } else {
-            printf("%s%s[WebSocket] %s%sHandshake failed%s with %s%s%s\n", 
-                   BOLD, COLOR_BLUE, BOLD, COLOR_RED, COLOR_RESET, 
-                   COLOR_CYAN, client_info, COLOR_RESET);
-        }
-    } else {
-        printf("%s%s[WebSocket] %s%sInvalid request%s from %s%s%s\n", 
-               BOLD, COLOR_RED, BOLD, COLOR_RED, COLOR_RESET, 
-               COLOR_CYAN, client_info, COLOR_RESET);
-        
-        printf("%s%s[WebSocket] %sHeaders from %s%s%s:\n%s%s%s\n", 
-               BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, client_info, COLOR_YELLOW, 
-               COLOR_MAGENTA, buffer, COLOR_RESET);
-    }
-    
-    close(client_socket);
-}
-
-
-int process_ws_frame(int client_socket, ws_clients_t* clients) {
+// Handles the frame at the start of data: bytes used, 0 while it is incomplete, -1 to close
+int process_ws_frame(int client_socket, const unsigned char* data, size_t length) {
     if (client_socket <= 0) return -1;
+    if (length < 2) return 0;
     
-    unsigned char header[2];
-    ssize_t bytes_read = recv(client_socket, header, 2, 0);
-    if (bytes_read < 2) {
-        return -1;
-    }
-    
-    bool fin = (header[0] & 0x80) != 0;
-    uint8_t opcode = header[0] & 0x0F;
-    bool masked = (header[1] & 0x80) != 0;
-    uint64_t payload_len = header[1] & 0x7F;
+    bool fin = (data[0] & 0x80) != 0;
+    uint8_t opcode = data[0] & 0x0F;
+    bool masked = (data[1] & 0x80) != 0;
+    uint64_t payload_len = data[1] & 0x7F;
     uint8_t mask_key[4] = {0};
+    size_t header_len = 2;
     if (payload_len == 126) {
+        if (length < 4) return 0;
         uint16_t len16;
-        bytes_read = recv(client_socket, &len16, 2, 0);
-        if (bytes_read < 2) return -1;
+        memcpy(&len16, data + 2, 2);
         payload_len = ntohs(len16);
+        header_len = 4;
     } else if (payload_len == 127) {
+        if (length < 10) return 0;
         uint64_t len64;
-        bytes_read = recv(client_socket, &len64, 8, 0);
-        if (bytes_read < 8) return -1;
+        memcpy(&len64, data + 2, 8);
         payload_len = ntohll(len64);
+        header_len = 10;
     }
     
     if (masked) {
-        bytes_read = recv(client_socket, mask_key, 4, 0);
-        if (bytes_read < 4) return -1;
+        if (length < header_len + 4) return 0;
+        memcpy(mask_key, data + header_len, 4);
+        header_len += 4;
     }
-    if (payload_len > BUFFER_SIZE - 1) {
-        payload_len = BUFFER_SIZE - 1;
+    if (payload_len > WS_MAX_PAYLOAD) {
+        return -1;
     }
+    if (length < header_len + payload_len) return 0;
+    
     unsigned char* payload = malloc(payload_len + 1);
     if (!payload) return -1;   
-    size_t bytes_to_read = payload_len;
-    size_t total_read = 0;
-    
-    while (total_read < bytes_to_read) {
-        bytes_read = recv(client_socket, payload + total_read, bytes_to_read - total_read, 0);
-        if (bytes_read <= 0) {
-            free(payload);
-            return -1;
-        }
-        total_read += bytes_read;
-    }
+    memcpy(payload, data + header_len, payload_len);
     
     if (masked) {
         for (size_t i = 0; i < payload_len; i++) {
@@ -627,49 +478,49 @@ int process_ws_frame(int client_socket, ws_clients_t* clients) {
     switch (opcode) {
         case WS_TEXT:
             if (strcmp((char*)payload, "ping") != 0 && strcmp((char*)payload, "pong") != 0) {
-                printf("%s%s[WebSocket] %sReceived text message: %s%s%s\n", 
-                       BOLD, COLOR_BLUE, COLOR_RESET, COLOR_GREEN, payload, COLOR_RESET);
+                REQUEST_LOG("%s%s[WebSocket] %sReceived text message: %s%s%s\n", 
+                            BOLD, COLOR_BLUE, COLOR_RESET, COLOR_GREEN, payload, COLOR_RESET);
             }
             if (strcmp((char*)payload, "ping") == 0) {
                 send_ws_frame(client_socket, "pong", 4, WS_TEXT);
             } else if (strcmp((char*)payload, "pong") == 0) {
-                printf("%s%s[WebSocket] %sReceived pong from client %s%d%s\n", 
-                       BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_YELLOW, client_socket, COLOR_RESET);
+                REQUEST_LOG("%s%s[WebSocket] %sReceived pong from client %s%d%s\n", 
+                            BOLD, COLOR_BLUE, COLOR_CYAN, COLOR_YELLOW, client_socket, COLOR_RESET);
             }
             break;
             
         case WS_BINARY:
-            printf("%s%s[WebSocket] %sReceived binary message (%s%zu%s bytes)\n", 
-                   BOLD, COLOR_BLUE, COLOR_RESET, COLOR_YELLOW, payload_len, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %sReceived binary message (%s%zu%s bytes)\n", 
+                        BOLD, COLOR_BLUE, COLOR_RESET, COLOR_YELLOW, payload_len, COLOR_RESET);
             break;
             
         case WS_CLOSE:
-            printf("%s%s[WebSocket] %sReceived close frame from client %s%d%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, client_socket, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %sReceived close frame from client %s%d%s\n", 
+                        BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_CYAN, client_socket, COLOR_RESET);
             send_ws_frame(client_socket, "", 0, WS_CLOSE);
-            remove_ws_client(clients, client_socket);
-            break;
+            free(payload);
+            return -1;
             
         case WS_PING:
-            printf("%s%s[WebSocket] %sReceived ping from client %s%d%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, client_socket, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %sReceived ping from client %s%d%s\n", 
+                        BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, client_socket, COLOR_RESET);
             send_ws_frame(client_socket, (char*)payload, payload_len, WS_PONG);
             break;
             
         case WS_PONG:
-            printf("%s%s[WebSocket] %sReceived pong from client %s%d%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, client_socket, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %sReceived pong from client %s%d%s\n", 
+                        BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_CYAN, client_socket, COLOR_RESET);
             break;
             
         default:
-            printf("%s%s[WebSocket] %sReceived unknown opcode %s%d%s from client %s%d%s\n", 
-                   BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_RED, opcode, COLOR_YELLOW, 
-                   COLOR_CYAN, client_socket, COLOR_RESET);
+            REQUEST_LOG("%s%s[WebSocket] %sReceived unknown opcode %s%d%s from client %s%d%s\n", 
+                        BOLD, COLOR_BLUE, COLOR_YELLOW, COLOR_RED, opcode, COLOR_YELLOW, 
+                        COLOR_CYAN, client_socket, COLOR_RESET);
             break;
     }
     
     free(payload);
-    return 0;
+    return (int)(header_len + payload_len);
 }
 
 void free_ws_clients(ws_clients_t* clients) {
@@ -0,0 +1,107 @@
+#include "worker_pool.h"
+#include "websocket.h"
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void* worker_main(void* arg) {
+    worker_pool_t* pool = (worker_pool_t*)arg;
+
+    place_thread(pool->role, -1);
+    while (atomic_load(&pool->running)) {
+        if (sem_wait(&pool->jobs_available) != 0) {
+            continue;
+        }
+
+        void* job;
+        while (!(job = mpmc_queue_pop(&pool->jobs)) && atomic_load(&pool->running)) {
+            sched_yield();
+        }
+        if (job) {
+            pool->handler(job);
+        }
+    }
+
+    return NULL;
+}
+
+worker_pool_t* init_worker_pool(int thread_count, worker_job_fn handler, placement_role_t role) {
+    if (thread_count <= 0 || !handler) {
+        return NULL;
+    }
+
+    worker_pool_t* pool = calloc(1, sizeof(worker_pool_t));
+    if (!pool) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to allocate worker pool%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+        return NULL;
+    }
+
+    pool->handler = handler;
+    pool->role = role;
+    atomic_init(&pool->running, true);
+
+    if (init_mpmc_queue(&pool->jobs, WORKER_QUEUE_SIZE) != 0 ||
+        sem_init(&pool->jobs_available, 0, 0) != 0) {
+        fprintf(stderr, "%s%s[ERROR] %sFailed to initialize worker queue%s\n",
+                BOLD, COLOR_RED, COLOR_RESET, COLOR_RESET);
+        free_mpmc_queue(&pool->jobs);
+        free(pool);
+        return NULL;
+    }
+
+    pool->threads = calloc(thread_count, sizeof(pthread_t));
+    if (!pool->threads) {
+        free_mpmc_queue(&pool->jobs);
+        sem_destroy(&pool->jobs_available);
+        free(pool);
+        return NULL;
+    }
+
+    for (int i = 0; i < thread_count; i++) {
+        if (pthread_create(&pool->threads[i], NULL, worker_main, pool) != 0) {
+            fprintf(stderr, "%s%s[ERROR] %sFailed to create worker thread %d: %s%s\n",
+                    BOLD, COLOR_RED, COLOR_RESET, i, strerror(errno), COLOR_RESET);
+            break;
+        }
+        pool->thread_count++;
+    }
+
+    if (pool->thread_count == 0) {
+        free_worker_pool(pool);
+        return NULL;
+    }
+
+    printf("%s%s[WORKERS] %sStarted %s%d%s worker thread(s)%s\n",
+           BOLD, COLOR_BLUE, COLOR_GREEN, COLOR_YELLOW, pool->thread_count, COLOR_GREEN, COLOR_RESET);
+    return pool;
+}
+
+bool submit_worker_job(worker_pool_t* pool, void* job) {
+    if (!mpmc_queue_push(&pool->jobs, job)) {
+        return false;
+    }
+    sem_post(&pool->jobs_available);
+    return true;
+}
+
+void free_worker_pool(worker_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+
+    atomic_store(&pool->running, false);
+    for (int i = 0; i < pool->thread_count; i++) {
+        sem_post(&pool->jobs_available);
+    }
+    for (int i = 0; i < pool->thread_count; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+
+    free(pool->threads);
+    sem_destroy(&pool->jobs_available);
+    free_mpmc_queue(&pool->jobs);
+    free(pool);
+}
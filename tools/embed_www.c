@@ -0,0 +1,439 @@
+/*
+ * Build-time generator for BLINK_EMBED_WWW: walks the web root and
+ * writes a C file holding every page and static asset, the compressed
+ * variants and ETags of the assets, and a hash-and-displace perfect
+ * hash over their paths.
+ *
+ * Usage: embed_www <web root> <output.c>
+ */
+#define _GNU_SOURCE
+#include "compression.h"
+#include "http_cache.h"
+#include "route_table.h"
+#include "static_types.h"
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#ifdef BLINK_BROTLI
+#include <brotli/encode.h>
+#endif
+
+#define EMBED_MAX_FILES 4096
+#define EMBED_MAX_SEED (1u << 24)
+
+typedef struct {
+    char* path;
+    unsigned char* data;
+    size_t size;
+    time_t mtime;
+    bool page;
+    char etag[ETAG_SIZE];
+    unsigned char* variants[ENCODING_COUNT];
+    size_t variant_sizes[ENCODING_COUNT];
+    char variant_etags[ENCODING_COUNT][ETAG_SIZE];
+} embed_file_t;
+
+typedef struct {
+    const char* extension;
+    bool compressible;
+} embed_type_t;
+
+#define EMBED_TYPE(ext, type, compressible) { ext, compressible },
+
+static const embed_type_t embed_types[] = {
+    STATIC_TYPES(EMBED_TYPE)
+};
+
+// Same order as content_encoding_t
+static const char* encoding_tokens[ENCODING_COUNT] = { "br", "gzip" };
+static const char* encoding_extensions[ENCODING_COUNT] = { ".br", ".gz" };
+
+static embed_file_t files[EMBED_MAX_FILES];
+static size_t file_count = 0;
+
+// 1 for a page, 2 for a compressible asset, 3 for any other asset, 0 to skip
+static int classify(const char* name) {
+    const char* ext = strrchr(name, '.');
+    if (!ext) {
+        return 0;
+    }
+    if (strcmp(ext, ".html") == 0) {
+        return 1;
+    }
+    for (size_t i = 0; i < sizeof(embed_types) / sizeof(embed_types[0]); i++) {
+        if (strcasecmp(ext, embed_types[i].extension) == 0) {
+            return embed_types[i].compressible ? 2 : 3;
+        }
+    }
+    return 0;
+}
+
+static unsigned char* read_file(const char* path, size_t* size) {
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return NULL;
+    }
+
+    struct stat st;
+    unsigned char* data = NULL;
+    if (fstat(fileno(file), &st) == 0 && (data = malloc((size_t)st.st_size + 1))) {
+        *size = fread(data, 1, (size_t)st.st_size, file);
+        if (*size != (size_t)st.st_size) {
+            free(data);
+            data = NULL;
+        }
+    }
+    fclose(file);
+    return data;
+}
+
+static unsigned char* compress_gzip(const unsigned char* data, size_t length, size_t* out_length) {
+    z_stream stream;
+    memset(&stream, 0, sizeof(stream));
+    if (deflateInit2(&stream, GZIP_LEVEL, Z_DEFLATED, 31, 9, Z_DEFAULT_STRATEGY) != Z_OK) {
+        return NULL;
+    }
+
+    size_t bound = deflateBound(&stream, length);
+    unsigned char* out = malloc(bound);
+    if (out) {
+        stream.next_in = (unsigned char*)data;
+        stream.avail_in = (uInt)length;
+        stream.next_out = out;
+        stream.avail_out = (uInt)bound;
+        if (deflate(&stream, Z_FINISH) == Z_STREAM_END) {
+            *out_length = stream.total_out;
+        } else {
+            free(out);
+            out = NULL;
+        }
+    }
+    deflateEnd(&stream);
+    return out;
+}
+
+static unsigned char* compress_variant(content_encoding_t encoding, const unsigned char* data, size_t length,
+                                       size_t* out_length) {
+    if (encoding == ENCODING_GZIP) {
+        return compress_gzip(data, length, out_length);
+    }
+#ifdef BLINK_BROTLI
+    size_t bound = BrotliEncoderMaxCompressedSize(length);
+    unsigned char* out = bound ? malloc(bound) : NULL;
+    *out_length = bound;
+    if (out && !BrotliEncoderCompress(BROTLI_MAX_QUALITY, BROTLI_DEFAULT_WINDOW, BROTLI_MODE_TEXT,
+                                      length, data, out_length, out)) {
+        free(out);
+        out = NULL;
+    }
+    return out;
+#else
+    return NULL;
+#endif
+}
+
+// Files compressed ahead of time win over the variants built here
+static void add_variants(embed_file_t* file, const char* path) {
+    uint64_t hash = xxh64(file->data, file->size, 0);
+    for (int i = 0; i < ENCODING_COUNT; i++) {
+        char sibling[1024];
+        snprintf(sibling, sizeof(sibling), "%s%s", path, encoding_extensions[i]);
+        file->variants[i] = read_file(sibling, &file->variant_sizes[i]);
+
+        if (!file->variants[i] && file->size >= COMPRESS_MIN_SIZE && file->size <= COMPRESS_MAX_SIZE) {
+            file->variants[i] = compress_variant((content_encoding_t)i, file->data, file->size,
+                                                 &file->variant_sizes[i]);
+            // Not worth a Content-Encoding if it barely shrinks
+            if (file->variants[i] && file->variant_sizes[i] >= file->size - file->size / 16) {
+                free(file->variants[i]);
+                file->variants[i] = NULL;
+            }
+        }
+        if (file->variants[i]) {
+            format_etag(file->variant_etags[i], ETAG_SIZE, hash, encoding_tokens[i]);
+        }
+    }
+}
+
+static int add_file(const char* path, const char* relative, int kind, time_t mtime) {
+    if (file_count >= EMBED_MAX_FILES) {
+        fprintf(stderr, "embed_www: more than %d files under the web root\n", EMBED_MAX_FILES);
+        return -1;
+    }
+
+    embed_file_t* file = &files[file_count];
+    file->path = strdup(relative);
+    file->data = read_file(path, &file->size);
+    if (!file->path || !file->data) {
+        fprintf(stderr, "embed_www: cannot read %s\n", path);
+        return -1;
+    }
+    file->mtime = mtime;
+    file->page = kind == 1;
+    if (!file->page) {
+        format_etag(file->etag, ETAG_SIZE, xxh64(file->data, file->size, 0), NULL);
+    }
+    if (kind == 2) {
+        add_variants(file, path);
+    }
+    file_count++;
+    return 0;
+}
+
+static int scan_directory(const char* root, const char* relative, int depth) {
+    char directory[1024];
+    snprintf(directory, sizeof(directory), "%s%s", root, relative);
+    DIR* dir = opendir(directory);
+    if (!dir) {
+        fprintf(stderr, "embed_www: cannot open %s\n", directory);
+        return -1;
+    }
+
+    int result = 0;
+    struct dirent* entry;
+    while (result == 0 && (entry = readdir(dir)) != NULL) {
+        // Dotfiles are never served, so they are never embedded
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        char child[1024];
+        char path[1024];
+        snprintf(child, sizeof(child), "%s/%s", relative, entry->d_name);
+        snprintf(path, sizeof(path), "%s%s", root, child);
+
+        struct stat st;
+        if (stat(path, &st) != 0) {
+            continue;
+        }
+        if (S_ISDIR(st.st_mode) && depth < ROUTE_MAX_DEPTH) {
+            result = scan_directory(root, child, depth + 1);
+        } else if (S_ISREG(st.st_mode) && classify(entry->d_name)) {
+            result = add_file(path, child, classify(entry->d_name), st.st_mtime);
+        }
+    }
+    closedir(dir);
+    return result;
+}
+
+static int compare_files(const void* a, const void* b) {
+    return strcmp(((const embed_file_t*)a)->path, ((const embed_file_t*)b)->path);
+}
+
+// Largest bucket first
+static int compare_buckets(const void* a, const void* b, void* sizes) {
+    size_t size_a = ((const size_t*)sizes)[*(const size_t*)a];
+    size_t size_b = ((const size_t*)sizes)[*(const size_t*)b];
+    return size_a < size_b ? 1 : size_a > size_b ? -1 : 0;
+}
+
+/*
+ * Hash and displace: keys are grouped into buckets by XXH64 with seed 0,
+ * then the largest buckets first each get the smallest seed that puts
+ * all their keys into free slots.
+ */
+static int build_perfect_hash(uint32_t* seeds, size_t bucket_count, int32_t* slots, size_t slot_count) {
+    size_t* bucket_of = calloc(file_count + 1, sizeof(size_t));
+    size_t* bucket_sizes = calloc(bucket_count, sizeof(size_t));
+    size_t* order = calloc(bucket_count, sizeof(size_t));
+    size_t* trial = calloc(file_count + 1, sizeof(size_t));
+    int result = bucket_of && bucket_sizes && order && trial ? 0 : -1;
+
+    for (size_t i = 0; result == 0 && i < file_count; i++) {
+        bucket_of[i] = xxh64(files[i].path, strlen(files[i].path), 0) % bucket_count;
+        bucket_sizes[bucket_of[i]]++;
+    }
+    for (size_t i = 0; i < slot_count; i++) {
+        slots[i] = -1;
+    }
+    for (size_t b = 0; result == 0 && b < bucket_count; b++) {
+        order[b] = b;
+        seeds[b] = 0;
+    }
+    if (result == 0) {
+        qsort_r(order, bucket_count, sizeof(size_t), compare_buckets, bucket_sizes);
+    }
+
+    for (size_t n = 0; result == 0 && n < bucket_count && bucket_sizes[order[n]] > 0; n++) {
+        size_t bucket = order[n];
+        uint32_t seed = 1;
+        for (; seed < EMBED_MAX_SEED; seed++) {
+            size_t placed = 0;
+            for (size_t i = 0; i < file_count; i++) {
+                if (bucket_of[i] != bucket) {
+                    continue;
+                }
+                size_t slot = xxh64(files[i].path, strlen(files[i].path), seed) % slot_count;
+                bool taken = slots[slot] >= 0;
+                for (size_t j = 0; j < placed && !taken; j++) {
+                    taken = trial[j] == slot;
+                }
+                if (taken) {
+                    break;
+                }
+                trial[placed++] = slot;
+            }
+            if (placed == bucket_sizes[bucket]) {
+                break;
+            }
+        }
+        if (seed == EMBED_MAX_SEED) {
+            result = -1;
+            break;
+        }
+
+        seeds[bucket] = seed;
+        for (size_t i = 0; i < file_count; i++) {
+            if (bucket_of[i] == bucket) {
+                slots[xxh64(files[i].path, strlen(files[i].path), seed) % slot_count] = (int32_t)i;
+            }
+        }
+    }
+
+    free(bucket_of);
+    free(bucket_sizes);
+    free(order);
+    free(trial);
+    return result;
+}
+
+static void write_string(FILE* out, const char* value) {
+    if (!value) {
+        fputs("NULL", out);
+        return;
+    }
+    fputc('"', out);
+    for (const unsigned char* p = (const unsigned char*)value; *p; p++) {
+        if (*p == '"' || *p == '\\') {
+            fprintf(out, "\\%c", *p);
+        } else if (*p < 0x20 || *p >= 0x7f) {
+            fprintf(out, "\\%03o", *p);
+        } else {
+            fputc(*p, out);
+        }
+    }
+    fputc('"', out);
+}
+
+static void write_bytes(FILE* out, const char* name, const unsigned char* data, size_t size) {
+    fprintf(out, "static const unsigned char %s[] = {", name);
+    for (size_t i = 0; i < size; i++) {
+        fprintf(out, i % 16 == 0 ? "\n    0x%02x," : " 0x%02x,", data[i]);
+    }
+    // An empty file still needs an array to point at
+    fprintf(out, "%s\n};\n\n", size == 0 ? "\n    0x00" : "");
+}
+
+static int write_output(const char* root, const char* output, const uint32_t* seeds, size_t bucket_count,
+                        const int32_t* slots, size_t slot_count) {
+    FILE* out = fopen(output, "w");
+    if (!out) {
+        fprintf(stderr, "embed_www: cannot write %s\n", output);
+        return -1;
+    }
+
+    fprintf(out, "/* Generated by tools/embed_www.c from %s, do not edit */\n", root);
+    fprintf(out, "#include \"embedded_files.h\"\n\n");
+
+    for (size_t i = 0; i < file_count; i++) {
+        char name[64];
+        snprintf(name, sizeof(name), "file_%zu", i);
+        write_bytes(out, name, files[i].data, files[i].size);
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            if (files[i].variants[e]) {
+                snprintf(name, sizeof(name), "file_%zu_%s", i, encoding_tokens[e]);
+                write_bytes(out, name, files[i].variants[e], files[i].variant_sizes[e]);
+            }
+        }
+    }
+
+    fprintf(out, "static const embedded_file_t files[] = {\n");
+    for (size_t i = 0; i < file_count; i++) {
+        const embed_file_t* file = &files[i];
+        fprintf(out, "    { ");
+        write_string(out, file->path);
+        fprintf(out, ", file_%zu, %zu, (time_t)%lld, ", i, file->size, (long long)file->mtime);
+        write_string(out, file->page ? NULL : file->etag);
+        fprintf(out, ",\n      {");
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            if (file->variants[e]) {
+                fprintf(out, " file_%zu_%s,", i, encoding_tokens[e]);
+            } else {
+                fprintf(out, " NULL,");
+            }
+        }
+        fprintf(out, " }, {");
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            fprintf(out, " %zu,", file->variants[e] ? file->variant_sizes[e] : 0);
+        }
+        fprintf(out, " }, {");
+        for (int e = 0; e < ENCODING_COUNT; e++) {
+            fputc(' ', out);
+            write_string(out, file->variants[e] ? file->variant_etags[e] : NULL);
+            fputc(',', out);
+        }
+        fprintf(out, " } },\n");
+    }
+    if (file_count == 0) {
+        fprintf(out, "    { NULL, NULL, 0, 0, NULL, { NULL }, { 0 }, { NULL } },\n");
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static const uint32_t seeds[] = {");
+    for (size_t b = 0; b < bucket_count; b++) {
+        fprintf(out, b % 8 == 0 ? "\n    %u," : " %u,", seeds[b]);
+    }
+    fprintf(out, "\n};\n\nstatic const int32_t slots[] = {");
+    for (size_t s = 0; s < slot_count; s++) {
+        fprintf(out, s % 8 == 0 ? "\n    %d," : " %d,", slots[s]);
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "const embedded_table_t embedded_www = { files, %zu, seeds, %zu, slots, %zu };\n",
+            file_count, bucket_count, slot_count);
+
+    int result = ferror(out) ? -1 : 0;
+    if (fclose(out) != 0) {
+        result = -1;
+    }
+    return result;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "Usage: %s <web root> <output.c>\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    if (scan_directory(argv[1], "", 0) != 0) {
+        return EXIT_FAILURE;
+    }
+    qsort(files, file_count, sizeof(embed_file_t), compare_files);
+
+    size_t bucket_count = file_count / 4 + 1;
+    size_t slot_count = file_count + file_count / 4 + 1;
+    uint32_t* seeds = calloc(bucket_count, sizeof(uint32_t));
+    int32_t* slots = NULL;
+    int built = -1;
+    // A table that will not settle gets more room
+    while (seeds && built != 0 && slot_count <= 4 * file_count + 1) {
+        free(slots);
+        slots = calloc(slot_count, sizeof(int32_t));
+        built = slots ? build_perfect_hash(seeds, bucket_count, slots, slot_count) : -1;
+        slot_count += built != 0 ? file_count / 4 + 1 : 0;
+    }
+    if (built != 0) {
+        fprintf(stderr, "embed_www: no perfect hash found for %zu files\n", file_count);
+        return EXIT_FAILURE;
+    }
+
+    if (write_output(argv[1], argv[2], seeds, bucket_count, slots, slot_count) != 0) {
+        return EXIT_FAILURE;
+    }
+    printf("embed_www: embedded %zu files from %s\n", file_count, argv[1]);
+    return EXIT_SUCCESS;
+}